@@ -0,0 +1,319 @@
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <irlib/basis.hpp>
+#include <irlib/compressed_basis.hpp>
+
+#ifndef IRLIB_SAMPLES_DIR
+#define IRLIB_SAMPLES_DIR "samples"
+#endif
+
+using namespace irlib;
+
+namespace {
+    typedef piecewise_polynomial<mpreal, mpreal> pp_type;
+    typedef Eigen::Matrix<mpreal, Eigen::Dynamic, Eigen::Dynamic> MatrixXmp;
+
+    struct benchmark_result {
+        std::string name;
+        int iterations;
+        double seconds_per_iteration;
+        double cpu_seconds_per_iteration;
+    };
+
+    /// Results are accumulated here so that the compiler cannot drop the benchmarked calls
+    double sink = 0.0;
+
+    class benchmark_runner {
+    public:
+        benchmark_runner(const std::string &filter, double min_time) : filter_(filter), min_time_(min_time) {}
+
+        /**
+         * Time f() by calling it repeatedly until min_time seconds have passed (macrobenchmarks are called once).
+         * Both the wall time and the CPU time of the process (summed over all threads) are measured.
+         * Benchmarks whose names do not contain the filter are skipped.
+         */
+        void run(const std::string &name, const std::function<void()> &f, bool macro = false) {
+            if (!selected(name)) {
+                return;
+            }
+            std::cerr << name << " ... " << std::flush;
+
+            int iterations = 0;
+            double elapsed = 0.0;
+            const std::clock_t cpu_start = std::clock();
+            auto start = std::chrono::steady_clock::now();
+            do {
+                f();
+                ++iterations;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (!macro && elapsed < min_time_);
+            const double cpu_elapsed = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+            results_.push_back(benchmark_result{name, iterations, elapsed / iterations, cpu_elapsed / iterations});
+            std::cerr << elapsed / iterations << " s" << std::endl;
+        }
+
+        /// Return true if the benchmark will run
+        bool selected(const std::string &name) const {
+            return name.find(filter_) != std::string::npos;
+        }
+
+        /// Return true if any of the benchmarks will run (used to skip their common setup)
+        bool any_selected(const std::vector<std::string> &names) const {
+            for (const auto &name : names) {
+                if (selected(name)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Write the results in the JSON format of Google Benchmark, so that its comparison tools can be used
+        void write_json(std::ostream &out) const {
+            out << "{\n";
+            out << "  \"context\": {\n";
+            out << "    \"library\": \"irlib\",\n";
+            out << "    \"num_cpus\": " << detail::default_num_threads() << "\n";
+            out << "  },\n";
+            out << "  \"benchmarks\": [\n";
+            for (int i = 0; i < results_.size(); ++i) {
+                const auto &r = results_[i];
+                out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                    << ", \"real_time\": " << r.seconds_per_iteration * 1e9
+                    << ", \"cpu_time\": " << r.cpu_seconds_per_iteration * 1e9
+                    << ", \"time_unit\": \"ns\"}" << (i + 1 < results_.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n";
+            out << "}" << std::endl;
+        }
+
+    private:
+        std::string filter_;
+        double min_time_;
+        std::vector<benchmark_result> results_;
+    };
+
+    std::vector<pp_type> u_functions(const basis &b) {
+        std::vector<pp_type> ul;
+        for (int l = 0; l < b.dim(); ++l) {
+            ul.push_back(b.ul(l));
+        }
+        return ul;
+    }
+
+    void kernel_benchmarks(benchmark_runner &runner, bool quick) {
+        ir_set_default_prec<mpreal>(169);
+
+        const fermionic_kernel<mpreal> kernel(100.0);
+        const detail::symmetrized_kernel<fermionic_kernel<mpreal>> kernel_even(kernel, 1);
+        const std::vector<mpreal> section_edges = linspace<mpreal>(0, 1, 11);
+        runner.run("matrix_rep/Lambda100/sections10/poly10", [&]() {
+            auto K = matrix_rep<mpreal>(kernel_even, section_edges, section_edges, 24, 10);
+            sink += static_cast<double>(K(0, 0));
+        });
+
+        // Input of the SVD benchmarks, built outside of them so that they can be selected without matrix_rep
+        if (runner.any_selected({"svd/mp/100x100", "svd/mp_compressed/100x100"})) {
+            const MatrixXmp Kmat = matrix_rep<mpreal>(kernel_even, section_edges, section_edges, 24, 10);
+
+            runner.run("svd/mp/100x100", [&]() {
+                Eigen::BDCSVD<MatrixXmp> svd(Kmat, Eigen::ComputeThinU | Eigen::ComputeThinV);
+                sink += static_cast<double>(svd.singularValues()[0]);
+            });
+
+            runner.run("svd/mp_compressed/100x100", [&]() {
+                MatrixXmp A(Kmat);
+                Eigen::Matrix<mpreal, Eigen::Dynamic, 1> svalues;
+                MatrixXmp U, V;
+                detail::compressed_svd(A, 1e-30, svalues, U, V);
+                sink += static_cast<double>(svalues[0]);
+            });
+        }
+
+        std::vector<double> Lambdas{10.0, 100.0};
+        if (!quick) {
+            Lambdas.push_back(1000.0);
+        }
+        for (auto Lambda : Lambdas) {
+            std::ostringstream name;
+            name << "generate_ir_basis_functions/Lambda" << Lambda;
+            runner.run(name.str(), [&]() {
+                const fermionic_kernel<mpreal> kernel_L(Lambda);
+                auto r = generate_ir_basis_functions<mpreal>(kernel_L, 1000, 1e-8, false, 1e-8);
+                sink += std::get<1>(r).size();
+            }, true);
+        }
+    }
+
+    void io_benchmarks(benchmark_runner &runner, const std::string &samples) {
+        const std::string file = samples + "/np10/basis_f-mp-Lambda1000.0.txt";
+        runner.run("loadtxt/Lambda1000", [&]() {
+            sink += loadtxt(file).dim();
+        });
+
+        if (runner.selected("savetxt/Lambda1000")) {
+            const basis b = loadtxt(file);
+            const std::string tmp_file = "benchmarks_savetxt.txt";
+            runner.run("savetxt/Lambda1000", [&]() {
+                savetxt(tmp_file, b);
+            });
+            std::remove(tmp_file.c_str());
+        }
+    }
+
+    /**
+     * Evaluation of the basis functions in x, y, Matsubara frequencies, and operations on the basis functions.
+     * "scalar" calls basis::ulx/vly for each l, and "batch" evaluates the same piecewise polynomials b.ul(l), b.vl(l)
+     * for all l at once, finding the section only once for each point.
+     * "compressed" evaluates all l at once with the double-precision re-fit of the basis (compressed_basis).
+     */
+    void basis_benchmarks(benchmark_runner &runner, const std::string &samples) {
+        const std::vector<std::string> names{
+                "ulx/scalar/Lambda1000", "vly/scalar/Lambda1000", "ulx/batch/Lambda1000", "vly/batch/Lambda1000",
+                "ulx/compressed/Lambda1000", "vly/compressed/Lambda1000", "compute_Tnl/Lambda1000/n6",
+                "find_zeros/Lambda1000", "cspline_approximation/Lambda1000"
+        };
+        if (!runner.any_selected(names)) {
+            return;
+        }
+
+        const basis b = loadtxt(samples + "/np10/basis_f-mp-Lambda1000.0.txt");
+        ir_set_default_prec<mpreal>(b.get_prec());
+        const int dim = b.dim();
+        const std::vector<double> xs = linspace<double>(-1, 1, 101);
+
+        runner.run("ulx/scalar/Lambda1000", [&]() {
+            for (auto x : xs) {
+                for (int l = 0; l < dim; ++l) {
+                    sink += b.ulx(l, x);
+                }
+            }
+        });
+        runner.run("vly/scalar/Lambda1000", [&]() {
+            for (auto y : xs) {
+                for (int l = 0; l < dim; ++l) {
+                    sink += b.vly(l, y);
+                }
+            }
+        });
+
+        const std::vector<pp_type> ul = u_functions(b);
+        std::vector<pp_type> vl;
+        for (int l = 0; l < dim; ++l) {
+            vl.push_back(b.vl(l));
+        }
+        std::vector<double> values(dim);
+        // f_l(x) for all l with f_l(-x) = (-1)^l f_l(x)
+        auto compute_all = [&](const std::vector<pp_type> &fl, double x) {
+            const mpreal abs_x(std::abs(x));
+            const int section = fl[0].find_section(abs_x);
+            for (int l = 0; l < dim; ++l) {
+                values[l] = static_cast<double>(fl[l].compute_value(abs_x, section));
+                if (x < 0 && l % 2 == 1) {
+                    values[l] *= -1;
+                }
+            }
+        };
+        runner.run("ulx/batch/Lambda1000", [&]() {
+            for (auto x : xs) {
+                compute_all(ul, x);
+                sink += values[dim - 1];
+            }
+        });
+        runner.run("vly/batch/Lambda1000", [&]() {
+            for (auto y : xs) {
+                compute_all(vl, y);
+                sink += values[dim - 1];
+            }
+        });
+
+        if (runner.any_selected({"ulx/compressed/Lambda1000", "vly/compressed/Lambda1000"})) {
+            const compressed_basis cb = compress(b);
+            runner.run("ulx/compressed/Lambda1000", [&]() {
+                for (auto x : xs) {
+                    cb.ulx_all(x, &values[0]);
+                    sink += values[dim - 1];
+                }
+            });
+            runner.run("vly/compressed/Lambda1000", [&]() {
+                for (auto y : xs) {
+                    cb.vly_all(y, &values[0]);
+                    sink += values[dim - 1];
+                }
+            });
+        }
+
+        const std::vector<long> n_vec{0, 1, 10, 100, 1000, 10000};
+        runner.run("compute_Tnl/Lambda1000/n6", [&]() {
+            Eigen::Tensor<std::complex<double>, 2> Tnl;
+            b.compute_Tnl(n_vec, Tnl);
+            sink += Tnl(0, 0).real();
+        });
+
+        runner.run("find_zeros/Lambda1000", [&]() {
+            sink += find_zeros(ul.back(), mpreal(1e-20)).size();
+        });
+
+        runner.run("cspline_approximation/Lambda1000", [&]() {
+            sink += cspline_approximation(ul, 1e-4).size();
+        });
+    }
+}
+
+/**
+ * Benchmarks of the hot paths of irlib.
+ * Usage: benchmarks [--samples dir] [--output file] [--filter substring] [--min-time seconds] [--quick]
+ * Results are printed in JSON to the standard output (or written into the output file), and progress to the standard error.
+ * --quick skips the most expensive macrobenchmarks.
+ */
+int main(int argc, char **argv) {
+    std::string samples = IRLIB_SAMPLES_DIR;
+    std::string output, filter;
+    double min_time = 0.5;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--samples" && i + 1 < argc) {
+            samples = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_time = std::atof(argv[++i]);
+        } else if (arg == "--quick") {
+            quick = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--samples dir] [--output file] [--filter substring] [--min-time seconds] [--quick]" << std::endl;
+            return 1;
+        }
+    }
+
+    benchmark_runner runner(filter, min_time);
+    try {
+        kernel_benchmarks(runner, quick);
+        io_benchmarks(runner, samples);
+        basis_benchmarks(runner, samples);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (output.empty()) {
+        runner.write_json(std::cout);
+    } else {
+        std::ofstream ofs(output);
+        runner.write_json(ofs);
+    }
+    std::cerr << "checksum " << sink << std::endl;
+    return 0;
+}
@@ -15,6 +15,8 @@
 
 #include "common.hpp"
 #include "kernel.hpp"
+#include "multi_double.hpp"
+#include "precision_plan.hpp"
 #include "piecewise_polynomial.hpp"
 
 #include "irlib/detail/basis_impl.ipp"
@@ -47,11 +49,28 @@ namespace irlib {
             v_basis_ = v_basis;
         }
 
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+        /**
+         * Constructor
+         * @param plan precisions used for generating the basis
+         */
+        basis(statistics::statistics_type s,
+              double Lambda,
+              const std::vector<mpfr::mpreal> &sv,
+              const std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> &u_basis,
+              const std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> &v_basis,
+              const precision_plan &plan
+        ) throw(std::runtime_error) : basis(s, Lambda, sv, u_basis, v_basis) {
+            plan_ = plan;
+        }
+#endif
+
     private:
         statistics::statistics_type statistics_;
         double Lambda_;
         std::vector<mpfr::mpreal> sv_;
         std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> u_basis_, v_basis_;
+        precision_plan plan_;
 
         //mutable mp_prec_t default_prec_bak;
 
@@ -335,6 +354,11 @@ namespace irlib {
             return ul(0).section_edge(0).get_prec();
         }
 
+        /// Precisions used for generating the basis (all zero if unknown, e.g. for a basis loaded from a file of version 1)
+        const precision_plan &get_precision_plan() const {
+            return plan_;
+        }
+
         /// Return statistics
         irlib::statistics::statistics_type get_statistics() const {
             return statistics_;
@@ -440,6 +464,66 @@ namespace irlib {
 
     };
 
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+    /**
+     * Compute an IR basis for a given kernel.
+     * Any kernel type satisfying the concept documented in kernel.hpp can be used.
+     * The kernel is a template parameter, so that calls to it in the construction of the kernel matrix are resolved at compile time.
+     * The precision of each phase is chosen by plan_precision() and recorded in the returned basis.
+     * The default precision of the calling thread is restored on return.
+     * @tparam ScalarType scalar type used for the SVD of the kernel matrix (mpfr::mpreal, qd_real, dd_real or long double)
+     * @param kernel kernel
+     * @param max_dim maximum number of basis functions
+     * @param cutoff cutoff for singular values relative to the largest one
+     * @param r_tol relative tolerance for the basis functions
+     * @param prec minimum precision in bits for all phases (a large value gives an all-high-precision result)
+     * @param n_local_poly number of Legendre polynomials in each section
+     * @param num_nodes_gauss_legendre number of Gauss-Legendre nodes in each section
+     * @param verbose print progress
+     * @param max_local_poly maximum number of Legendre polynomials in a section.
+     *    If this is larger than n_local_poly, sections get more Legendre polynomials instead of being bisected,
+     *    except for the section at x, y = 1 when its Legendre coefficients do not decay fast enough.
+     * @param compression_tol if positive, the kernel matrix is compressed to a low-rank form with this relative tolerance
+     *    before the SVD, which saves time and memory for large Lambda.
+     *    Errors in the basis functions are of the order of compression_tol / cutoff, so a value below cutoff * r_tol is recommended.
+     * @param num_threads number of threads for estimating the residuals of the integral equations
+     *    (a value <= 0 means the number of hardware threads)
+     * @return basis
+     */
+    template<typename ScalarType = mpfr::mpreal, typename K>
+    typename std::enable_if<detail::is_kernel<K>::value, basis>::type
+    compute_basis(const K &kernel,
+                  int max_dim = 1000,
+                  double cutoff = 1e-8,
+                  double r_tol = 1e-8,
+                  long prec = 64,
+                  int n_local_poly = 10,
+                  int num_nodes_gauss_legendre = 24,
+                  bool verbose = true,
+                  int max_local_poly = 0,
+                  double compression_tol = 0,
+                  int num_threads = 0
+    ) throw(std::runtime_error) {
+        max_local_poly = std::max(max_local_poly, n_local_poly);
+        std::vector<mpfr::mpreal> sv;
+        std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> u_basis;
+        std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> v_basis;
+
+        const precision_plan plan = plan_precision(kernel.Lambda(), cutoff, r_tol, prec, max_local_poly);
+        if (verbose) {
+            std::cout << "Precisions : " << plan << std::endl;
+        }
+
+        // Section edges and basis functions are stored in the precision of the conversion phase.
+        detail::scoped_default_prec scoped_prec(plan.conversion);
+        std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<ScalarType>(
+                kernel, max_dim, cutoff, verbose, r_tol, n_local_poly, num_nodes_gauss_legendre, plan, max_local_poly,
+                compression_tol, num_threads);
+
+        return basis(kernel.get_statistics(), kernel.Lambda(), sv, u_basis, v_basis, plan);
+    }
+#endif
+
     inline basis compute_basis(statistics::statistics_type s,
                         double Lambda,
                         int max_dim = 1000,
@@ -449,61 +533,73 @@ namespace irlib {
                         long prec = 64,
                         int n_local_poly = 10,
                         int num_nodes_gauss_legendre = 24,
-                        bool verbose = true
+                        bool verbose = true,
+                        double compression_tol = 0,
+                        int num_threads = 0
         ) throw(std::runtime_error) {
-        std::vector<mpfr::mpreal> sv;
-        std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> u_basis;
-        std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> v_basis;
-
-        // Increase default precision if needed
-        auto min_prec = std::max(
-                mpfr::digits2bits(std::log10(1/cutoff)+2*std::log10(1/r_tol)),
-                long(64)//At least 19 digits
-        );
-        //min_prec = std::max(min_prec, mpfr::digits2bits(std::log10(1/r_tol))+10);
-        min_prec = std::max(min_prec, prec);
-        if (min_prec > mpfr::mpreal::get_default_prec()) {
-            mpfr::mpreal::set_default_prec(min_prec);
-        }
-        if (verbose) {
-            std::cout << "Using default precision = " << min_prec << " bits." << std::endl;
+        if (s != statistics::FERMIONIC && s != statistics::BOSONIC) {
+            throw std::runtime_error("Unknown statistics.");
         }
 
         if (fp_mode == "mp") {
             if (s == statistics::FERMIONIC) {
-                std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<mpfr::mpreal>(
-                        fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, verbose, r_tol, n_local_poly, num_nodes_gauss_legendre);
-            } else if (s == statistics::BOSONIC) {
-                std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<mpfr::mpreal>(
-                        bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, verbose, r_tol, n_local_poly, num_nodes_gauss_legendre);
+                return compute_basis<mpfr::mpreal>(fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                                   n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            } else {
+                return compute_basis<mpfr::mpreal>(bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                                   n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
             }
         } else if (fp_mode == "long double") {
             if (cutoff < 1e-8) {
                 std::cout << "Warning : cutoff cannot be smaller than 1e-8 for long-double precision version. Please use fp_mode='mp'!" << std::endl;
             }
             if (s == statistics::FERMIONIC) {
-                std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<long double>(
-                        fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, verbose, r_tol, n_local_poly, num_nodes_gauss_legendre);
-            } else if (s == statistics::BOSONIC) {
-                std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<long double>(
-                        bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, verbose, r_tol, n_local_poly, num_nodes_gauss_legendre);
+                return compute_basis<long double>(fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                                  n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            } else {
+                return compute_basis<long double>(bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                                  n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            }
+        } else if (fp_mode == "dd") {
+            if (cutoff < 1e-16) {
+                std::cout << "Warning : cutoff cannot be smaller than 1e-16 for double-double precision version. Please use fp_mode='qd' or 'mp'!" << std::endl;
+            }
+            if (s == statistics::FERMIONIC) {
+                return compute_basis<dd_real>(fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                              n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            } else {
+                return compute_basis<dd_real>(bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                              n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            }
+        } else if (fp_mode == "qd") {
+            if (cutoff < 1e-32) {
+                std::cout << "Warning : cutoff cannot be smaller than 1e-32 for quad-double precision version. Please use fp_mode='mp'!" << std::endl;
+            }
+            if (s == statistics::FERMIONIC) {
+                return compute_basis<qd_real>(fermionic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                              n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
+            } else {
+                return compute_basis<qd_real>(bosonic_kernel<mpfr::mpreal>(Lambda), max_dim, cutoff, r_tol, prec,
+                                              n_local_poly, num_nodes_gauss_legendre, verbose, 0, compression_tol, num_threads);
             }
         } else {
-            throw std::runtime_error("Unknown fp_mode " + fp_mode + ". Only 'mp' is supported.");
+            throw std::runtime_error("Unknown fp_mode " + fp_mode + ". Only 'mp', 'qd', 'dd' and 'long double' are supported.");
         }
-
-        return basis(s, Lambda, sv, u_basis, v_basis);
     }
 
     inline void savetxt(const std::string& fname, const basis& b) throw(std::runtime_error) {
         std::ofstream ofs(fname);
 
-        int version = 1;
+        int version = 2;
         ofs << version << std::endl;
         ofs << b.get_statistics() << std::endl;
         ofs << b.Lambda() << std::endl;
         ofs << b.dim() << std::endl;
 
+        const auto &plan = b.get_precision_plan();
+        ofs << plan.approximate_nodes << " " << plan.kernel_matrix << " " << plan.svd << " "
+            << plan.conversion << " " << plan.residual << std::endl;
+
         ofs << b.sl_mp(0).get_prec() << std::endl;
         for (int l=0; l<b.dim(); ++l) {
             auto sl = b.sl_mp(l);
@@ -531,7 +627,8 @@ namespace irlib {
         int version;
         ifs >> version;
 
-        if (version == 1) {
+        // Version 2 records the precisions used for generating the basis
+        if (version == 1 || version == 2) {
             {
                 int itmp;
                 ifs >> itmp;
@@ -540,6 +637,11 @@ namespace irlib {
             ifs >> Lambda;
             ifs >> dim;
 
+            precision_plan plan;
+            if (version == 2) {
+                ifs >> plan.approximate_nodes >> plan.kernel_matrix >> plan.svd >> plan.conversion >> plan.residual;
+            }
+
             mpfr_prec_t prec;
             ifs >> prec;
             std::vector<mpfr::mpreal> sv(dim);
@@ -558,7 +660,7 @@ namespace irlib {
                 ifs >> v_basis[l];
             }
 
-            return basis(s, Lambda, sv, u_basis, v_basis);
+            return basis(s, Lambda, sv, u_basis, v_basis, plan);
         } else {
             throw std::runtime_error("Version " + std::to_string(version) + " is not supported!");
         }
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "basis.hpp"
+#include "detail/parallel.hpp"
+
+namespace irlib {
+    /**
+     * Parameters of a basis to be generated by compute_bases.
+     * The meanings of the parameters are the same as those of compute_basis.
+     */
+    struct basis_job {
+        statistics::statistics_type statistics;
+        double Lambda;
+        int max_dim = 1000;
+        double cutoff = 1e-8;
+        double r_tol = 1e-8;
+        long prec = 64;
+        int n_local_poly = 10;
+        int num_nodes_gauss_legendre = 24;
+        double compression_tol = 0;
+        /// Output file. If empty, output_file_name() is used.
+        std::string output;
+    };
+
+    /// Default output file name for a job, e.g. "basis_f-mp-Lambda100.0.txt"
+    inline std::string output_file_name(const basis_job &job) {
+        std::ostringstream out;
+        out << "basis_" << (job.statistics == statistics::FERMIONIC ? "f" : "b") << "-mp-Lambda";
+        if (job.Lambda == std::floor(job.Lambda)) {
+            out << std::fixed << std::setprecision(1);
+        }
+        out << job.Lambda << ".txt";
+        return out.str();
+    }
+
+    /**
+     * Read a list of jobs.
+     * Each line reads
+     * "statistics Lambda [max_dim cutoff r_tol prec n_local_poly num_nodes_gauss_legendre [compression_tol] [output]]",
+     * where statistics is F or B. A number following num_nodes_gauss_legendre is read as compression_tol,
+     * and anything else as output. Empty lines and lines starting with # are ignored.
+     * @param in input stream
+     * @return jobs
+     */
+    inline std::vector<basis_job> read_basis_jobs(std::istream &in) throw(std::runtime_error) {
+        std::vector<basis_job> jobs;
+        std::string line;
+        int line_number = 0;
+        while (std::getline(in, line)) {
+            ++line_number;
+            std::istringstream iss(line);
+            std::string s;
+            if (!(iss >> s) || s[0] == '#') {
+                continue;
+            }
+
+            basis_job job;
+            if (s == "F") {
+                job.statistics = statistics::FERMIONIC;
+            } else if (s == "B") {
+                job.statistics = statistics::BOSONIC;
+            } else {
+                throw std::runtime_error("Unknown statistics " + s + " at line " + std::to_string(line_number));
+            }
+            if (!(iss >> job.Lambda)) {
+                throw std::runtime_error("Lambda is missing at line " + std::to_string(line_number));
+            }
+            if (iss >> job.max_dim) {
+                if (!(iss >> job.cutoff >> job.r_tol >> job.prec >> job.n_local_poly >> job.num_nodes_gauss_legendre)) {
+                    throw std::runtime_error("Too few parameters at line " + std::to_string(line_number));
+                }
+                std::string token;
+                if (iss >> token) {
+                    std::istringstream iss_token(token);
+                    double compression_tol;
+                    if (iss_token >> compression_tol && iss_token.eof()) {
+                        job.compression_tol = compression_tol;
+                        iss >> job.output;
+                    } else {
+                        job.output = token;
+                    }
+                }
+            }
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    /**
+     * Generate bases for many parameters on a shared pool of threads.
+     * Jobs are started in increasing order of Lambda, so that cheap jobs finish first,
+     * and idle threads pick up the next job as soon as they finish one.
+     * Immutable tables such as Gauss-Legendre nodes are cached per process and shared by all jobs.
+     * Each job starts from the default precision of the calling thread, so the results do not depend on scheduling.
+     * Each job runs on a single thread, so that the number of threads never exceeds num_threads.
+     * @param jobs jobs
+     * @param on_finish called with the job and the basis as soon as each job finishes (calls are serialized)
+     * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+     * @param verbose print progress
+     * @return number of failed jobs
+     */
+    inline int compute_bases(const std::vector<basis_job> &jobs,
+                             const std::function<void(const basis_job &, const basis &)> &on_finish,
+                             int num_threads = 0,
+                             bool verbose = true) {
+        std::vector<int> order(jobs.size());
+        for (int i = 0; i < jobs.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int i, int j) { return jobs[i].Lambda < jobs[j].Lambda; });
+
+        const mp_prec_t prec = mpfr::mpreal::get_default_prec();
+        std::mutex mutex;
+        int num_failed = 0;
+
+        detail::parallel_for(jobs.size(), [&](int i) {
+            const auto &job = jobs[order[i]];
+            auto prec_bak = mpfr::mpreal::get_default_prec();
+            mpfr::mpreal::set_default_prec(prec);
+            try {
+                auto b = compute_basis(job.statistics, job.Lambda, job.max_dim, job.cutoff, "mp", job.r_tol, job.prec,
+                                       job.n_local_poly, job.num_nodes_gauss_legendre, false, job.compression_tol, 1);
+                std::lock_guard<std::mutex> lock(mutex);
+                on_finish(job, b);
+                if (verbose) {
+                    std::cout << "Lambda = " << job.Lambda << " (" << (job.statistics == statistics::FERMIONIC ? "F" : "B")
+                              << ") : " << b.dim() << " basis functions." << std::endl;
+                }
+            } catch (const std::exception &e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++num_failed;
+                std::cerr << "Lambda = " << job.Lambda << " (" << (job.statistics == statistics::FERMIONIC ? "F" : "B")
+                          << ") failed : " << e.what() << std::endl;
+            }
+            mpfr::mpreal::set_default_prec(prec_bak);
+        }, num_threads);
+
+        return num_failed;
+    }
+
+    /// Generate bases and save them into files as soon as each job finishes
+    inline int compute_bases(const std::vector<basis_job> &jobs, int num_threads = 0, bool verbose = true) {
+        return compute_bases(jobs, [](const basis_job &job, const basis &b) {
+            savetxt(job.output.empty() ? output_file_name(job) : job.output, b);
+        }, num_threads, verbose);
+    }
+}
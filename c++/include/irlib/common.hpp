@@ -6,7 +6,7 @@
 #include <Eigen/CXX11/Tensor>
 
 #include "piecewise_polynomial.hpp"
-#include "detail/gauss_legendre.hpp"
+#include "detail/gauss_legendre_cache.hpp"
 #include "detail/legendre_polynomials.hpp"
 
 namespace irlib {
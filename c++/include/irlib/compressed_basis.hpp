@@ -0,0 +1,436 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+#include "basis.hpp"
+#include "detail/parallel.hpp"
+
+namespace irlib {
+
+/**
+ * Class representing a set of functions f_l(x) (l = 0, ..., L-1) by piecewise polynomials sharing the same sections.
+ *   In each section [x_s, x_{s+1}), f_l(x) = \sum_{p=0}^k a_{s,l,p} (x - x_s)^p.
+ *   The coefficients of all the functions in a section are stored contiguously,
+ *   so that all the functions can be evaluated at a given x with a single section lookup.
+ */
+    template<typename T>
+    class piecewise_polynomial_block {
+    public:
+        piecewise_polynomial_block() : k_(-1), num_functions_(0) {}
+
+        /**
+         * Constructor
+         * @param k order of polynomials
+         * @param num_functions number of functions
+         * @param section_edges edges of sections
+         * @param coeff coefficients a_{s,l,p} stored at coeff[(s * num_functions + l) * (k + 1) + p]
+         */
+        piecewise_polynomial_block(int k, int num_functions, const std::vector<T> &section_edges, const std::vector<T> &coeff)
+                : k_(k), num_functions_(num_functions), section_edges_(section_edges), coeff_(coeff) {
+            if (section_edges_.size() < 2 || coeff_.size() != num_sections() * num_functions_ * (k_ + 1)) {
+                throw std::runtime_error("piecewise_polynomial_block: inconsistent sizes of section edges and coefficients.");
+            }
+        }
+
+        /// Convert a vector of piecewise polynomials sharing the same sections and order
+        template<typename S, typename Sx>
+        explicit piecewise_polynomial_block(const std::vector<piecewise_polynomial<S, Sx>> &pps)
+                : k_(pps[0].order()), num_functions_(pps.size()) {
+            const int ns = pps[0].num_sections();
+            section_edges_.resize(ns + 1);
+            for (int s = 0; s < ns + 1; ++s) {
+                section_edges_[s] = static_cast<T>(pps[0].section_edge(s));
+            }
+            coeff_.resize(ns * num_functions_ * (k_ + 1));
+            for (int l = 0; l < num_functions_; ++l) {
+                if (pps[l].order() != k_ || pps[l].section_edges() != pps[0].section_edges()) {
+                    throw std::runtime_error("piecewise_polynomial_block: all functions must have the same sections and order.");
+                }
+                for (int s = 0; s < ns; ++s) {
+                    for (int p = 0; p < k_ + 1; ++p) {
+                        coeff_[(s * num_functions_ + l) * (k_ + 1) + p] = static_cast<T>(pps[l].coefficient(s, p));
+                    }
+                }
+            }
+        }
+
+        /// Order of the polynomials
+        int order() const {
+            return k_;
+        }
+
+        /// Number of functions
+        int num_functions() const {
+            return num_functions_;
+        }
+
+        /// Number of sections
+        int num_sections() const {
+            return section_edges_.size() - 1;
+        }
+
+        /// Return a reference to end points
+        const std::vector<T> &section_edges() const {
+            return section_edges_;
+        }
+
+        /// Return the coefficient of (x-x_s)^p of the l-th function for the given section
+        T coefficient(int s, int l, int p) const {
+            return coeff_[(s * num_functions_ + l) * (k_ + 1) + p];
+        }
+
+        /// Find the section involving the given x
+        int find_section(T x) const {
+            if (x <= section_edges_[0]) {
+                return 0;
+            } else if (x >= section_edges_.back()) {
+                return section_edges_.size() - 2;
+            }
+            return std::upper_bound(section_edges_.begin(), section_edges_.end(), x) - section_edges_.begin() - 1;
+        }
+
+        /// Compute the value of the l-th function at x
+        T compute_value(int l, T x) const {
+            const int s = find_section(x);
+            const T dx = x - section_edges_[s];
+            const T *c = &coeff_[(s * num_functions_ + l) * (k_ + 1)];
+            T r = c[k_];
+            for (int p = k_ - 1; p >= 0; --p) {
+                r = r * dx + c[p];
+            }
+            return r;
+        }
+
+        /// Compute the values of all the functions at x. The results are stored in values[0], ..., values[L-1].
+        void compute_values(T x, T *values) const {
+            const int s = find_section(x);
+            const T dx = x - section_edges_[s];
+            const T *c = &coeff_[s * num_functions_ * (k_ + 1)];
+            for (int l = 0; l < num_functions_; ++l, c += k_ + 1) {
+                T r = c[k_];
+                for (int p = k_ - 1; p >= 0; --p) {
+                    r = r * dx + c[p];
+                }
+                values[l] = r;
+            }
+        }
+
+    private:
+        int k_, num_functions_;
+        std::vector<T> section_edges_;
+        std::vector<T> coeff_;
+    };
+
+    namespace detail {
+        /**
+         * Approximate all the functions of a block by double-precision piecewise polynomials of order k
+         * with adaptively placed section edges.
+         * In each section, the functions are interpolated at Chebyshev nodes.
+         * The errors are checked at 4(k+1) points inside each section for all the functions together
+         * (the reference functions may be discontinuous at the initial section edges),
+         * and a section is bisected until the error of every function relative to its maximum absolute value is below r_tol.
+         * The maximum absolute values are taken over all the points where the functions are evaluated.
+         * A section narrower than min_width is accepted even if its error is above r_tol,
+         * so the caller must check max_rel_error.
+         * @param ref reference functions
+         * @param initial_edges initial section edges
+         * @param k order of polynomials
+         * @param r_tol relative tolerance
+         * @param max_rel_error achieved maximum relative error on the check points
+         */
+        inline piecewise_polynomial_block<double>
+        compress_functions(const piecewise_polynomial_block<long double> &ref,
+                           const std::vector<double> &initial_edges,
+                           int k, double r_tol, double &max_rel_error, int num_threads) {
+            using matrix_t = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>;
+
+            const int L = ref.num_functions();
+            const int num_check = 4 * (k + 1);
+            const double min_width = 1e-15;
+            const int num_initial_sections = initial_edges.size() - 1;
+
+            // Interpolation nodes on [0, 1] and inverse of the Vandermonde matrix, shared by all sections
+            std::vector<double> t_nodes(k + 1), t_check(num_check);
+            for (int i = 0; i < k + 1; ++i) {
+                t_nodes[i] = 0.5 * (1 - std::cos(M_PI * (i + 0.5) / (k + 1)));
+            }
+            for (int i = 0; i < num_check; ++i) {
+                t_check[i] = (i + 0.5) / num_check;
+            }
+            matrix_t vandermonde(k + 1, k + 1);
+            for (int i = 0; i < k + 1; ++i) {
+                for (int p = 0; p < k + 1; ++p) {
+                    vandermonde(i, p) = std::pow(t_nodes[i], p);
+                }
+            }
+            const matrix_t inv_vandermonde = vandermonde.inverse();
+
+            // Scale of each function estimated on the nodes and the check points of the initial sections
+            std::vector<double> scale(L, 0.0);
+            {
+                std::vector<std::vector<double>> scale_section(num_initial_sections, std::vector<double>(L, 0.0));
+                parallel_for(num_initial_sections, [&](int s) {
+                    const double a = initial_edges[s], h = initial_edges[s + 1] - initial_edges[s];
+                    std::vector<long double> values(L);
+                    auto update = [&](double t) {
+                        ref.compute_values(a + h * t, &values[0]);
+                        for (int l = 0; l < L; ++l) {
+                            scale_section[s][l] = std::max(scale_section[s][l], static_cast<double>(std::abs(values[l])));
+                        }
+                    };
+                    std::for_each(t_nodes.begin(), t_nodes.end(), update);
+                    std::for_each(t_check.begin(), t_check.end(), update);
+                }, num_threads);
+                for (const auto &scale_s : scale_section) {
+                    for (int l = 0; l < L; ++l) {
+                        scale[l] = std::max(scale[l], scale_s[l]);
+                    }
+                }
+            }
+
+            // Approximate [a, b] recursively. Results are appended to edges and coeffs in ascending order of x.
+            struct section_result {
+                std::vector<double> edges;
+                std::vector<double> coeffs;
+                std::vector<double> max_abs_error, max_abs_value;
+            };
+            std::function<void(double, double, section_result &)> approximate = [&](double a, double b, section_result &r) {
+                const double h = b - a;
+                std::vector<long double> values(L);
+
+                std::vector<double> abs_error(L, 0.0), abs_value(L, 0.0);
+
+                matrix_t Y(k + 1, L);
+                for (int i = 0; i < k + 1; ++i) {
+                    ref.compute_values(a + h * t_nodes[i], &values[0]);
+                    for (int l = 0; l < L; ++l) {
+                        Y(i, l) = static_cast<double>(values[l]);
+                        abs_value[l] = std::max(abs_value[l], std::abs(Y(i, l)));
+                    }
+                }
+                // Coefficients in t = (x-a)/h for all functions at once
+                matrix_t C = inv_vandermonde * Y;
+
+                double err = 0.0;
+                for (int i = 0; i < num_check; ++i) {
+                    ref.compute_values(a + h * t_check[i], &values[0]);
+                    for (int l = 0; l < L; ++l) {
+                        double v = C(k, l);
+                        for (int p = k - 1; p >= 0; --p) {
+                            v = v * t_check[i] + C(p, l);
+                        }
+                        abs_error[l] = std::max(abs_error[l], std::abs(static_cast<double>(values[l] - v)));
+                        abs_value[l] = std::max(abs_value[l], static_cast<double>(std::abs(values[l])));
+                        if (scale[l] > 0) {
+                            err = std::max(err, abs_error[l] / scale[l]);
+                        }
+                    }
+                }
+
+                if (err > r_tol && h > min_width) {
+                    approximate(a, a + 0.5 * h, r);
+                    approximate(a + 0.5 * h, b, r);
+                    return;
+                }
+
+                for (int l = 0; l < L; ++l) {
+                    r.max_abs_error[l] = std::max(r.max_abs_error[l], abs_error[l]);
+                    r.max_abs_value[l] = std::max(r.max_abs_value[l], abs_value[l]);
+                }
+                r.edges.push_back(a);
+                double inv_h_pow = 1.0;
+                std::vector<double> c(L * (k + 1));
+                for (int p = 0; p < k + 1; ++p) {
+                    for (int l = 0; l < L; ++l) {
+                        c[l * (k + 1) + p] = C(p, l) * inv_h_pow;
+                    }
+                    inv_h_pow /= h;
+                }
+                r.coeffs.insert(r.coeffs.end(), c.begin(), c.end());
+            };
+
+            std::vector<section_result> results(num_initial_sections);
+            parallel_for(num_initial_sections, [&](int s) {
+                results[s].max_abs_error.resize(L, 0.0);
+                results[s].max_abs_value.resize(L, 0.0);
+                approximate(initial_edges[s], initial_edges[s + 1], results[s]);
+            }, num_threads);
+
+            std::vector<double> edges, coeffs, max_abs_error(L, 0.0);
+            for (const auto &r : results) {
+                edges.insert(edges.end(), r.edges.begin(), r.edges.end());
+                coeffs.insert(coeffs.end(), r.coeffs.begin(), r.coeffs.end());
+                for (int l = 0; l < L; ++l) {
+                    max_abs_error[l] = std::max(max_abs_error[l], r.max_abs_error[l]);
+                    scale[l] = std::max(scale[l], r.max_abs_value[l]);
+                }
+            }
+            edges.push_back(initial_edges.back());
+
+            max_rel_error = 0.0;
+            for (int l = 0; l < L; ++l) {
+                if (scale[l] > 0) {
+                    max_rel_error = std::max(max_rel_error, max_abs_error[l] / scale[l]);
+                }
+            }
+
+            return piecewise_polynomial_block<double>(k, L, edges, coeffs);
+        }
+    }
+
+/**
+ * Class representing u_l(x) and v_l(y) of an IR basis by double-precision piecewise polynomials of low order.
+ * Section edges are shared by all l, and the maximum error relative to max_x |u_l(x)| (max_y |v_l(y)|)
+ * is controlled. This representation is meant for fast evaluation in hot loops.
+ */
+    class compressed_basis {
+    public:
+        compressed_basis() {}
+
+        compressed_basis(statistics::statistics_type s,
+                         double Lambda,
+                         const std::vector<double> &sv,
+                         const piecewise_polynomial_block<double> &u_basis,
+                         const piecewise_polynomial_block<double> &v_basis,
+                         double max_rel_error)
+                : statistics_(s), Lambda_(Lambda), sv_(sv), u_basis_(u_basis), v_basis_(v_basis),
+                  max_rel_error_(max_rel_error) {}
+
+        /// Return number of basis functions
+        int dim() const { return sv_.size(); }
+
+        /// Return statistics
+        statistics::statistics_type get_statistics() const {
+            return statistics_;
+        }
+
+        double Lambda() const {
+            return Lambda_;
+        }
+
+        double sl(int l) const {
+            assert(l >= 0 && l < dim());
+            return sv_[l];
+        }
+
+        /// Maximum relative error found on the check points during the construction (never above the requested r_tol)
+        double max_rel_error() const {
+            return max_rel_error_;
+        }
+
+        /// Representation of u_l(x) on [0, 1]
+        const piecewise_polynomial_block<double> &u_basis() const {
+            return u_basis_;
+        }
+
+        /// Representation of v_l(y) on [0, 1]
+        const piecewise_polynomial_block<double> &v_basis() const {
+            return v_basis_;
+        }
+
+        /// Return the value of u_l(x) for x in [-1, 1]
+        double ulx(int l, double x) const {
+            assert(x >= -1 && x <= 1);
+            assert(l >= 0 && l < dim());
+            return x >= 0 ? u_basis_.compute_value(l, x) : (l % 2 == 0 ? 1 : -1) * u_basis_.compute_value(l, -x);
+        }
+
+        /// Return the value of v_l(y) for y in [-1, 1]
+        double vly(int l, double y) const {
+            assert(y >= -1 && y <= 1);
+            assert(l >= 0 && l < dim());
+            return y >= 0 ? v_basis_.compute_value(l, y) : (l % 2 == 0 ? 1 : -1) * v_basis_.compute_value(l, -y);
+        }
+
+        /// Compute u_l(x) for all l at once. The results are stored in values[0], ..., values[dim()-1].
+        void ulx_all(double x, double *values) const {
+            compute_all(u_basis_, x, values);
+        }
+
+        /// Compute v_l(y) for all l at once. The results are stored in values[0], ..., values[dim()-1].
+        void vly_all(double y, double *values) const {
+            compute_all(v_basis_, y, values);
+        }
+
+    private:
+        statistics::statistics_type statistics_;
+        double Lambda_;
+        std::vector<double> sv_;
+        piecewise_polynomial_block<double> u_basis_, v_basis_;
+        double max_rel_error_;
+
+        void compute_all(const piecewise_polynomial_block<double> &f, double x, double *values) const {
+            assert(x >= -1 && x <= 1);
+            f.compute_values(std::abs(x), values);
+            if (x < 0) {
+                for (int l = 1; l < dim(); l += 2) {
+                    values[l] *= -1;
+                }
+            }
+        }
+    };
+
+    /**
+     * Convert an IR basis into double-precision piecewise polynomials of low order with a controlled error.
+     * Section edges are placed adaptively for all l together, starting from the section edges of the original basis
+     * and the zeros of the highest basis function.
+     * The reference values are computed from the coefficients of the original basis converted into long double.
+     * A std::runtime_error is thrown if the error relative to the maximum absolute value sampled on the check points
+     * is above r_tol somewhere, which can happen when r_tol is close to the precision of double.
+     * @param b basis
+     * @param r_tol maximum error relative to max_x |u_l(x)| (max_y |v_l(y)|)
+     * @param order order of the piecewise polynomials
+     * @param num_threads number of threads
+     * @return compressed basis
+     */
+    inline compressed_basis compress(const basis &b, double r_tol = 1e-10, int order = 5, int num_threads = 0) {
+        if (order < 1) {
+            throw std::runtime_error("compress: order must be at least 1.");
+        }
+        if (r_tol < 1e-14) {
+            throw std::runtime_error("compress: r_tol must be at least 1e-14 for double-precision piecewise polynomials.");
+        }
+
+        detail::scoped_default_prec scoped_prec(b.get_prec());
+
+        auto compress_pp = [&](const std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> &pps, double &max_rel_error) {
+            // The original basis functions are not exactly continuous at their section edges.
+            std::set<double> edges_set;
+            for (const auto &x : pps[0].section_edges()) {
+                edges_set.insert(static_cast<double>(x));
+            }
+            for (const auto &x : find_zeros(pps.back(), mpfr::mpreal(1e-12))) {
+                edges_set.insert(static_cast<double>(x));
+            }
+            std::vector<double> initial_edges(edges_set.begin(), edges_set.end());
+            return detail::compress_functions(
+                    piecewise_polynomial_block<long double>(pps), initial_edges, order, r_tol, max_rel_error, num_threads
+            );
+        };
+
+        std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> u, v;
+        std::vector<double> sv;
+        for (int l = 0; l < b.dim(); ++l) {
+            u.push_back(b.ul(l));
+            v.push_back(b.vl(l));
+            sv.push_back(b.sl(l));
+        }
+
+        double max_rel_error_u, max_rel_error_v;
+        auto u_basis = compress_pp(u, max_rel_error_u);
+        auto v_basis = compress_pp(v, max_rel_error_v);
+        if (std::max(max_rel_error_u, max_rel_error_v) > r_tol) {
+            throw std::runtime_error("compress: r_tol could not be achieved. Use a larger r_tol or a higher order.");
+        }
+
+        return compressed_basis(b.get_statistics(), b.Lambda(), sv, u_basis, v_basis,
+                                std::max(max_rel_error_u, max_rel_error_v));
+    }
+}
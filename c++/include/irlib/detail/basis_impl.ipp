@@ -1,12 +1,19 @@
 #pragma once
 
 #include <algorithm>
+#include <map>
+#include <numeric>
 
 #include <Eigen/Core>
 #include <Eigen/CXX11/Tensor>
 
 #include "../piecewise_polynomial.hpp"
+#include "../precision_plan.hpp"
+#include "kernel_traits.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
 #include "spline.hpp"
+#include "truncated_svd.hpp"
 
 namespace irlib {
     //template<typename T>
@@ -53,7 +60,7 @@ namespace irlib {
 
     template<typename Tx, typename Ty, typename F>
     Ty integrate_gauss_legendre(const std::vector<Tx>& section_edges, const F& f, int num_local_nodes) {
-        std::vector<std::pair<Tx, Tx>> nodes = detail::gauss_legendre_nodes<Tx>(num_local_nodes);
+        const std::vector<std::pair<Tx, Tx>> &nodes = detail::gauss_legendre_nodes<Tx>(num_local_nodes);
         auto nodes_x = composite_gauss_legendre_nodes(section_edges, nodes);
         Ty r = 0;
         for (int n=0; n<nodes_x.size(); ++n) {
@@ -62,15 +69,91 @@ namespace irlib {
         return r;
     };
 
+    /**
+     * Compute the overlap matrix <f1_l | f2_m> between two families of piecewise polynomials.
+     * The integrand is a polynomial in each section of the common refinement of the two meshes.
+     * It is integrated exactly by Gauss-Legendre quadrature, and the whole matrix is obtained by a single matrix product.
+     * @param f1 piecewise polynomials sharing the same sections and order
+     * @param f2 piecewise polynomials sharing the same sections and order
+     * @param num_threads number of threads used for evaluating the functions at the quadrature nodes
+     * @return overlap matrix with complex conjugate of f1 (L1 x L2)
+     */
+    template<typename T, typename Tx>
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>
+    overlap_matrix(const std::vector<piecewise_polynomial<T,Tx>> &f1,
+                   const std::vector<piecewise_polynomial<T,Tx>> &f2,
+                   int num_threads = 0) {
+        using matrix_t = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+        if (f1.size() == 0 || f2.size() == 0) {
+            return matrix_t(f1.size(), f2.size());
+        }
+
+        auto check_family = [](const std::vector<piecewise_polynomial<T,Tx>> &f) {
+            for (const auto &p : f) {
+                if (p.order() != f[0].order() || p.section_edges() != f[0].section_edges()) {
+                    throw std::runtime_error("overlap_matrix: piecewise polynomials must have the same sections and order.");
+                }
+            }
+        };
+        check_family(f1);
+        check_family(f2);
+
+        const auto &edges1 = f1[0].section_edges();
+        const auto &edges2 = f2[0].section_edges();
+        const auto section_edges = detail::merge_section_edges(edges1, edges2);
+        const int num_sec = section_edges.size() - 1;
+
+        // Gauss-Legendre quadrature with n nodes is exact for polynomials of degree 2n-1.
+        const int degree = f1[0].order() + f2[0].order();
+        const int num_local_nodes = degree / 2 + 1;
+        const auto &local_nodes = detail::gauss_legendre_nodes<Tx>(num_local_nodes);
+        const auto nodes = composite_gauss_legendre_nodes(section_edges, local_nodes);
+
+        // Index of the section of each family containing each section of the common mesh
+        std::vector<int> sec1(num_sec), sec2(num_sec);
+        for (int s = 0, s1 = 0, s2 = 0; s < num_sec; ++s) {
+            while (edges1[s1 + 1] <= section_edges[s]) ++s1;
+            while (edges2[s2 + 1] <= section_edges[s]) ++s2;
+            sec1[s] = s1;
+            sec2[s] = s2;
+        }
+
+        // Values of the functions multiplied by the square root of the weights at the quadrature nodes
+        matrix_t A1(nodes.size(), f1.size()), A2(nodes.size(), f2.size());
+        detail::parallel_for(num_sec, [&](int s) {
+            for (int n = s * num_local_nodes; n < (s + 1) * num_local_nodes; ++n) {
+                const auto &x = nodes[n].first;
+                const T sqrt_w = detail::x_to_coeff<T>(detail::sqrt<Tx>(nodes[n].second));
+                for (int l = 0; l < f1.size(); ++l) {
+                    A1(n, l) = f1[l].compute_value(x, sec1[s]) * sqrt_w;
+                }
+                for (int l = 0; l < f2.size(); ++l) {
+                    A2(n, l) = f2[l].compute_value(x, sec2[s]) * sqrt_w;
+                }
+            }
+        }, num_threads);
+
+        return A1.adjoint() * A2;
+    }
+
     /**
      * Compute Matrix representation of a given Kernel
+     * Each section may have its own number of Legendre polynomials.
+     * The basis functions of the s-th section occupy a contiguous block of rows (columns),
+     * which starts at the sum of the numbers of Legendre polynomials of the preceding sections.
+     * A section with base_local_poly (or fewer) Legendre polynomials is integrated with num_local_nodes Gauss-Legendre nodes,
+     * and two nodes are added for each additional Legendre polynomial.
+     * The number of nodes of a section thus depends only on its own number of Legendre polynomials.
      * @tparam Scalar
      * @tparam K
      * @param kernel
      * @param section_edges_x
      * @param section_edges_y
      * @param num_local_nodes
-     * @param num_local_poly
+     * @param num_local_poly_x number of Legendre polynomials in each section for x
+     * @param num_local_poly_y number of Legendre polynomials in each section for y
+     * @param base_local_poly number of Legendre polynomials for which num_local_nodes nodes are used
      * @return Matrix representation
      */
     template<typename Scalar, typename K>
@@ -79,62 +162,86 @@ namespace irlib {
                const std::vector<mpreal> &section_edges_x,
                const std::vector<mpreal> &section_edges_y,
                int num_local_nodes,
-               int num_local_poly) {
+               const std::vector<int> &num_local_poly_x,
+               const std::vector<int> &num_local_poly_y,
+               int base_local_poly) {
 
         using mpreal_matrix_type = Eigen::Matrix<mpreal, Eigen::Dynamic, Eigen::Dynamic>;
         using matrix_type = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
 
         int num_sec_x = section_edges_x.size() - 1;
         int num_sec_y = section_edges_y.size() - 1;
+        assert(num_local_poly_x.size() == num_sec_x);
+        assert(num_local_poly_y.size() == num_sec_y);
 
-        // nodes for Gauss-Legendre integration
-        std::vector<std::pair<mpreal, mpreal >> nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
-        auto nodes_x = composite_gauss_legendre_nodes(section_edges_x, nodes);
-        auto nodes_y = composite_gauss_legendre_nodes(section_edges_y, nodes);
+        const int max_local_poly = std::max(
+                *std::max_element(num_local_poly_x.begin(), num_local_poly_x.end()),
+                *std::max_element(num_local_poly_y.begin(), num_local_poly_y.end())
+        );
 
-        std::vector<mpreal_matrix_type> phi_x(num_sec_x);
-        for (int s = 0; s < num_sec_x; ++s) {
-            phi_x[s] = mpreal_matrix_type(num_local_poly, num_local_nodes);
-            for (int n = 0; n < num_local_nodes; ++n) {
-                for (int l = 0; l < num_local_poly; ++l) {
-                    auto leg_val = normalized_legendre_p(l, nodes[n].first);
-                    phi_x[s](l, n) = detail::sqrt<mpreal>(mpreal(2) / (section_edges_x[s + 1] - section_edges_x[s])) * leg_val *
-                                     nodes_x[s * num_local_nodes + n].second;
+        // Normalized Legendre polynomials at the local nodes, shared by all sections with the same number of nodes
+        std::map<int, mpreal_matrix_type> leg_vals;
+        auto num_nodes_section = [&](int num_local_poly) {
+            const int num_nodes = num_local_nodes + 2 * std::max(0, num_local_poly - base_local_poly);
+            if (leg_vals.find(num_nodes) == leg_vals.end()) {
+                const auto &nodes = detail::gauss_legendre_nodes<mpreal>(num_nodes);
+                std::vector<mpreal> local_x(num_nodes);
+                for (int n = 0; n < num_nodes; ++n) {
+                    local_x[n] = nodes[n].first;
                 }
+                normalized_legendre_p_all(max_local_poly, local_x, leg_vals[num_nodes]);
             }
-        }
+            return num_nodes;
+        };
 
-        std::vector<mpreal_matrix_type> phi_y(num_sec_y);
-        for (int s = 0; s < num_sec_y; ++s) {
-            phi_y[s] = mpreal_matrix_type(num_local_poly, num_local_nodes);
-            for (int n = 0; n < num_local_nodes; ++n) {
-                for (int l = 0; l < num_local_poly; ++l) {
-                    auto leg_val = normalized_legendre_p(l, nodes[n].first);
-                    phi_y[s](l, n) = detail::sqrt<mpreal>(mpreal("2") / (section_edges_y[s + 1] - section_edges_y[s])) * leg_val *
-                                     nodes_y[s * num_local_nodes + n].second;
+        // phi(l, n): Legendre polynomials multiplied by the weights at the nodes of each section
+        // Nodes at which the kernel is evaluated are rounded to Scalar.
+        auto gen_phi = [&](const std::vector<mpreal> &section_edges, const std::vector<int> &num_local_poly,
+                           std::vector<mpreal_matrix_type> &phi, std::vector<std::vector<mpreal>> &local_nodes,
+                           std::vector<int> &offset) {
+            const int num_sec = section_edges.size() - 1;
+            phi.resize(num_sec);
+            local_nodes.resize(num_sec);
+            offset.resize(num_sec + 1);
+            offset[0] = 0;
+            for (int s = 0; s < num_sec; ++s) {
+                const int num_nodes = num_nodes_section(num_local_poly[s]);
+                const auto &nodes = detail::gauss_legendre_nodes<mpreal>(num_nodes);
+                const mpreal &a = section_edges[s];
+                const mpreal half_width = (section_edges[s + 1] - a) / mpreal(2);
+                const mpreal coeff = detail::sqrt<mpreal>(mpreal(1) / half_width);
+                phi[s] = mpreal_matrix_type(num_local_poly[s], num_nodes);
+                local_nodes[s].resize(num_nodes);
+                for (int n = 0; n < num_nodes; ++n) {
+                    const mpreal w = half_width * nodes[n].second;
+                    for (int l = 0; l < num_local_poly[s]; ++l) {
+                        phi[s](l, n) = coeff * leg_vals[num_nodes](l, n) * w;
+                    }
+                    local_nodes[s][n] = static_cast<mpreal>(static_cast<Scalar>(a + half_width * (nodes[n].first + mpreal(1))));
                 }
+                offset[s + 1] = offset[s] + num_local_poly[s];
             }
-        }
+        };
+
+        std::vector<mpreal_matrix_type> phi_x, phi_y;
+        std::vector<std::vector<mpreal>> local_nodes_x, local_nodes_y;
+        std::vector<int> offset_x, offset_y;
+        gen_phi(section_edges_x, num_local_poly_x, phi_x, local_nodes_x, offset_x);
+        gen_phi(section_edges_y, num_local_poly_y, phi_y, local_nodes_y, offset_y);
 
-        matrix_type K_mat(num_sec_x * num_local_poly, num_sec_y * num_local_poly);
+        matrix_type K_mat(offset_x.back(), offset_y.back());
         for (int s2 = 0; s2 < num_sec_y; ++s2) {
             for (int s = 0; s < num_sec_x; ++s) {
 
-                mpreal_matrix_type K_nn(num_local_nodes, num_local_nodes);
-                for (int n = 0; n < num_local_nodes; ++n) {
-                    for (int n2 = 0; n2 < num_local_nodes; ++n2) {
-                        K_nn(n, n2) = kernel(static_cast<Scalar>(nodes_x[s * num_local_nodes + n].first),
-                                             static_cast<Scalar>(nodes_y[s2 * num_local_nodes + n2].first)
-                        );
-                    }
-                }
+                mpreal_matrix_type K_nn;
+                detail::evaluate_kernel(kernel, local_nodes_x[s], local_nodes_y[s2], K_nn);
 
                 // phi_x(l, n) * K_nn(n, n2) * phi_y(l2, n2)^T
                 mpreal_matrix_type r = phi_x[s] * K_nn * phi_y[s2].transpose();
 
-                for (int l2 = 0; l2 < num_local_poly; ++l2) {
-                    for (int l = 0; l < num_local_poly; ++l) {
-                        K_mat(num_local_poly * s + l, num_local_poly * s2 + l2) = static_cast<Scalar>(r(l, l2));
+                for (int l2 = 0; l2 < num_local_poly_y[s2]; ++l2) {
+                    for (int l = 0; l < num_local_poly_x[s]; ++l) {
+                        K_mat(offset_x[s] + l, offset_y[s2] + l2) = static_cast<Scalar>(r(l, l2));
                     }
                 }
             }
@@ -143,6 +250,101 @@ namespace irlib {
         return K_mat;
     }
 
+    /**
+     * Compute Matrix representation of a given Kernel
+     * @tparam Scalar
+     * @tparam K
+     * @param kernel
+     * @param section_edges_x
+     * @param section_edges_y
+     * @param num_local_nodes
+     * @param num_local_poly
+     * @return Matrix representation
+     */
+    template<typename Scalar, typename K>
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>
+    matrix_rep(const K &kernel,
+               const std::vector<mpreal> &section_edges_x,
+               const std::vector<mpreal> &section_edges_y,
+               int num_local_nodes,
+               int num_local_poly) {
+        return matrix_rep<Scalar>(kernel, section_edges_x, section_edges_y, num_local_nodes,
+                                  std::vector<int>(section_edges_x.size() - 1, num_local_poly),
+                                  std::vector<int>(section_edges_y.size() - 1, num_local_poly), num_local_poly);
+    }
+
+    /**
+     * Estimate absolute errors in ulx and vly by computing the residuals of the integral equations
+     *   r_l(x) = u_l(x) - s_l^{-1} int_0^1 K(x,y) v_l(y) dy
+     *   for many l at once. This returns estimates of max_x |r_l(x)| sampled at the midpoints of the sections of u_l.
+     * The functions v_l are evaluated at the Gauss-Legendre nodes only once, and the kernel is evaluated only once
+     * for each pair of x and a node (using its batch evaluation if available), independently of the number of l.
+     * The x points are distributed over threads.
+     * @tparam K
+     * @param ux defined on [0, 1] (all sharing the same sections)
+     * @param vy defined on [0, 1] (all sharing the same sections)
+     * @param s singular values
+     * @param kernel a function of (x, y)
+     * @param num_local_nodes number of Gauss-Legendre nodes in each section of vy
+     * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+     * @return residuals for ux
+     */
+    template<typename K>
+    std::vector<double> estimate_residuals(const std::vector<piecewise_polynomial<mpreal,mpreal>>& ux,
+                                           const std::vector<piecewise_polynomial<mpreal,mpreal>>& vy,
+                                           const std::vector<mpreal>& s, const K& kernel, int num_local_nodes,
+                                           int num_threads = 0) {
+        using matrix_t = Eigen::Matrix<mpreal, Eigen::Dynamic, Eigen::Dynamic>;
+
+        const int num_l = ux.size();
+        assert(vy.size() == num_l && s.size() == num_l);
+        if (num_l == 0) {
+            return std::vector<double>();
+        }
+
+        const auto &section_edges_x = ux[0].section_edges();
+        const auto &section_edges_y = vy[0].section_edges();
+        const int num_sec_x = section_edges_x.size() - 1;
+        const int num_sec_y = section_edges_y.size() - 1;
+
+        const auto &local_nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
+        const auto nodes_y = composite_gauss_legendre_nodes(section_edges_y, local_nodes);
+        std::vector<mpreal> y(nodes_y.size());
+        for (int n = 0; n < nodes_y.size(); ++n) {
+            y[n] = nodes_y[n].first;
+        }
+
+        // w_n v_l(y_n)
+        matrix_t wv(nodes_y.size(), num_l);
+        detail::parallel_for(num_sec_y, [&](int sec) {
+            for (int n = sec * num_local_nodes; n < (sec + 1) * num_local_nodes; ++n) {
+                for (int l = 0; l < num_l; ++l) {
+                    wv(n, l) = nodes_y[n].second * vy[l].compute_value(nodes_y[n].first, sec);
+                }
+            }
+        }, num_threads);
+
+        // Residuals at the midpoints of the sections for x
+        matrix_t r(num_sec_x, num_l);
+        detail::parallel_for(num_sec_x, [&](int sec) {
+            const mpreal x = (section_edges_x[sec + 1] + section_edges_x[sec]) / 2;
+            detail::kernel_matrix_t k_row;
+            detail::evaluate_kernel(kernel, std::vector<mpreal>{x}, y, k_row);
+            const matrix_t integral = k_row * wv;
+            for (int l = 0; l < num_l; ++l) {
+                r(sec, l) = integral(0, l) / s[l] - ux[l].compute_value(x, sec);
+            }
+        }, num_threads);
+
+        std::vector<double> residual(num_l, 0.0);
+        for (int l = 0; l < num_l; ++l) {
+            for (int sec = 0; sec < num_sec_x; ++sec) {
+                residual[l] = std::max(residual[l], std::abs(static_cast<double>(r(sec, l))));
+            }
+        }
+        return residual;
+    }
+
     /**
      * Estimate absolute errors in ulx and vly by computing the residual of the integral equation
      *   r(x) = u(x) - s^{-1} int_0^1 K(x,y) v(y) dy
@@ -151,39 +353,15 @@ namespace irlib {
      * @param ux defined on [0, 1]
      * @param vy defined on [0, 1]
      * @param kernel a function of (x, y)
+     * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
      * @return residual for ux
      */
-    template<typename T, typename K>
-    double estimate_residual(const piecewise_polynomial<T,T>& ux, const piecewise_polynomial<T,T>& vy, T s, const K& kernel, int num_local_nodes) {
-        auto section_edges_x = ux.section_edges();
-        auto section_edges_y = vy.section_edges();
-
-        auto local_nodes = detail::gauss_legendre_nodes<mpfr::mpreal>(num_local_nodes);
-        auto nodes_y = composite_gauss_legendre_nodes(section_edges_y, local_nodes);
-
-        std::vector<T> sampling_points(section_edges_x);
-        for (int i=0; i < section_edges_x.size()-1; ++i) {
-            auto dx = section_edges_x[i+1]-section_edges_x[i];
-            sampling_points.push_back(0.25*dx + section_edges_x[i]);
-            sampling_points.push_back(0.50*dx + section_edges_x[i]);
-            sampling_points.push_back(0.75*dx + section_edges_x[i]);
-        }
-
-        // Now we compute residual for u_l(x)
-        double residual_x = 0.0;
-        for (auto i = 0; i < section_edges_x.size()-1; ++i) {
-            auto x = (section_edges_x[i+1] + section_edges_x[i])/2;
-            mpfr::mpreal sum(0);
-            for (int n=0; n < nodes_y.size(); ++n) {
-                auto y = nodes_y[n].first;
-                auto w = nodes_y[n].second;
-                sum += w * kernel(x,y) * vy.compute_value(y);
-            }
-            auto diff = mpfr::abs(sum/s - ux.compute_value(x));
-            residual_x = std::max(residual_x, static_cast<double>(diff));
-        }
-
-        return residual_x;
+    template<typename K>
+    double estimate_residual(const piecewise_polynomial<mpreal,mpreal>& ux, const piecewise_polynomial<mpreal,mpreal>& vy,
+                             const mpreal &s, const K& kernel, int num_local_nodes, int num_threads = 0) {
+        return estimate_residuals(std::vector<piecewise_polynomial<mpreal,mpreal>>{ux},
+                                  std::vector<piecewise_polynomial<mpreal,mpreal>>{vy},
+                                  std::vector<mpreal>{s}, kernel, num_local_nodes, num_threads)[0];
     }
 
     template<typename SVD>
@@ -213,8 +391,21 @@ namespace irlib {
      *
      * @tparam ScalarType
      * @tparam KernelType
+     * @num_local_poly_x number of Legendre polynomials in each section for x
+     * @num_local_poly_y number of Legendre polynomials in each section for y
+     * @base_local_poly number of Legendre polynomials of a section integrated with num_nodes_gauss_legendre nodes
+     *    (see matrix_rep)
+     * @residual_x absolute error in each section for x estimated by the last Legendre coefficient of ulx for largest l
+     * @residual_y absolute error in each section for y estimated by the last Legendre coefficient of vly for largest l
+     * @decay_x decay rate of the Legendre coefficients per order in each section for x (1 if it cannot be estimated)
+     * @decay_y decay rate of the Legendre coefficients per order in each section for y (1 if it cannot be estimated)
      * @r_int_eq absolute errors in ulx and vly estimated by the residual of integral equations. This estimate may be too big
      *    for very small singular values because the residual contains the inverse of singular values.
+     * @plan precisions used in the construction of the kernel matrix, the SVD, the conversion into piecewise polynomials
+     *    and the estimation of residuals
+     * @compression_tol if positive, the kernel matrix is compressed to this relative tolerance before the SVD
+     *    (see detail::compressed_svd)
+     * @num_threads number of threads for estimating the residuals of the integral equations
      */
     template<typename ScalarType, typename KernelType>
     std::tuple<
@@ -226,50 +417,111 @@ namespace irlib {
             const KernelType &kernel,
             int max_dim,
             double sv_cutoff,
-            int num_local_poly,
+            const std::vector<int> &num_local_poly_x,
+            const std::vector<int> &num_local_poly_y,
+            int base_local_poly,
             int num_nodes_gauss_legendre,
             const std::vector<mpreal> &section_edges_x,
             const std::vector<mpreal> &section_edges_y,
             std::vector<double> &residual_x,
             std::vector<double> &residual_y,
+            std::vector<double> &decay_x,
+            std::vector<double> &decay_y,
             std::pair<double,double>& r_int_eq,
-            bool verbose
+            bool verbose,
+            const precision_plan &plan = precision_plan(),
+            double compression_tol = 0,
+            int num_threads = 0
     ) throw(std::runtime_error) {
         using vector_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, 1>;
         using matrix_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, Eigen::Dynamic>;
         using mp_vector_t = Eigen::Matrix<mpreal, Eigen::Dynamic, 1>;
         using mp_matrix_t = Eigen::Matrix<mpreal, Eigen::Dynamic, Eigen::Dynamic>;
 
-        if (num_local_poly < 2) {
-            throw std::runtime_error("num_local_poly < 2! : " + std::to_string(num_local_poly));
+        const int min_local_poly = std::min(
+                *std::min_element(num_local_poly_x.begin(), num_local_poly_x.end()),
+                *std::min_element(num_local_poly_y.begin(), num_local_poly_y.end())
+        );
+        const int max_local_poly = std::max(
+                *std::max_element(num_local_poly_x.begin(), num_local_poly_x.end()),
+                *std::max_element(num_local_poly_y.begin(), num_local_poly_y.end())
+        );
+        if (min_local_poly < 2) {
+            throw std::runtime_error("num_local_poly < 2! : " + std::to_string(min_local_poly));
         }
 
-        // Compute Kernel matrix and do SVD for even/odd sector
+        // SVD of the kernel matrix of a sector (the matrix is destroyed if it is compressed)
+        auto svd_sector = [&](matrix_t &Kmat, vector_t &svalues, matrix_t &U, matrix_t &V) {
+            if (compression_tol > 0) {
+                detail::compressed_svd(Kmat, compression_tol, svalues, U, V);
+                if (verbose) {
+                    std::cout << "(rank " << svalues.size() << " of " << std::min(Kmat.rows(), Kmat.cols()) << ")";
+                }
+            } else {
+                Eigen::BDCSVD<matrix_t> svd(Kmat, Eigen::ComputeThinU | Eigen::ComputeThinV);
+                svalues = svd.singularValues();
+                U = svd.matrixU();
+                V = svd.matrixV();
+            }
+        };
+
+        // Keep only singular vectors that can be picked up below (at most max_cols of them).
+        // The rest of the thin U and V is released right after each SVD.
+        auto retain_columns = [&](const ScalarType &s0, int max_cols, vector_t &svalues, matrix_t &U, matrix_t &V) {
+            int num_cols = 0;
+            while (num_cols < std::min(max_cols, static_cast<int>(svalues.size())) && !(svalues[num_cols] / s0 < sv_cutoff)) {
+                ++num_cols;
+            }
+            svalues = svalues.head(num_cols).eval();
+            U = U.leftCols(num_cols).eval();
+            V = V.leftCols(num_cols).eval();
+        };
+
+        // Compute Kernel matrix and do SVD for even/odd sector.
+        // Each kernel matrix is freed as soon as it is factorized, so that at most one of them is alive at a time.
         if (verbose) {
             std::cout << "  Constructing kernel matrix for even sector ... "  << std::flush;
         }
-        auto kernel_even = [&](const mpreal &x, const mpreal &y) { return kernel(x, y) + kernel(x, -y); };
-        auto Kmat_even = irlib::matrix_rep<ScalarType>(
-                kernel_even, section_edges_x, section_edges_y, num_nodes_gauss_legendre, num_local_poly
-        );
+        const detail::symmetrized_kernel<KernelType> kernel_even(kernel, 1);
+        matrix_t Kmat_even;
+        {
+            detail::scoped_default_prec scoped_prec(plan.kernel_matrix);
+            Kmat_even = irlib::matrix_rep<ScalarType>(
+                    kernel_even, section_edges_x, section_edges_y, num_nodes_gauss_legendre, num_local_poly_x, num_local_poly_y,
+                    base_local_poly
+            );
+        }
         if (verbose) {
             std::cout << " done " << std::endl;
             std::cout << "  SVD kernel matrix for even sector ... " << std::flush;
         }
-        Eigen::BDCSVD<matrix_t> svd_even(Kmat_even, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        detail::scoped_default_prec scoped_prec_svd(plan.svd);
+        vector_t svalues_even, svalues_odd;
+        matrix_t U_even, V_even, U_odd, V_odd;
+        svd_sector(Kmat_even, svalues_even, U_even, V_even);
+        Kmat_even.resize(0, 0);
+        const ScalarType s0 = svalues_even[0];
+        retain_columns(s0, (max_dim + 1) / 2, svalues_even, U_even, V_even);
         if (verbose) {
             std::cout << " done " << std::endl;
             std::cout << "  Constructing kernel matrix for odd sector ... " << std::flush;
         }
-        auto kernel_odd = [&](const mpreal &x, const mpreal &y) { return kernel(x, y) - kernel(x, -y); };
-        auto Kmat_odd = irlib::matrix_rep<ScalarType>(
-                kernel_odd, section_edges_x, section_edges_y, num_nodes_gauss_legendre, num_local_poly
-        );
+        const detail::symmetrized_kernel<KernelType> kernel_odd(kernel, -1);
+        matrix_t Kmat_odd;
+        {
+            detail::scoped_default_prec scoped_prec(plan.kernel_matrix);
+            Kmat_odd = irlib::matrix_rep<ScalarType>(
+                    kernel_odd, section_edges_x, section_edges_y, num_nodes_gauss_legendre, num_local_poly_x, num_local_poly_y,
+                    base_local_poly
+            );
+        }
         if (verbose) {
             std::cout << " done " << std::endl;
             std::cout << "  SVD kernel matrix for odd sector ... " << std::flush;
         }
-        Eigen::BDCSVD<matrix_t> svd_odd(Kmat_odd, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        svd_sector(Kmat_odd, svalues_odd, U_odd, V_odd);
+        Kmat_odd.resize(0, 0);
+        retain_columns(s0, max_dim / 2, svalues_odd, U_odd, V_odd);
         if (verbose) {
             std::cout << " done " << std::endl;
         }
@@ -277,22 +529,25 @@ namespace irlib {
         // Pick up singular values and basis functions larger than cutoff
         std::vector<mpfr::mpreal> sv;
         std::vector<vector_t> Uvec, Vvec;
-        auto s0 = svd_even.singularValues()[0];
-        for (int i = 0; i < svd_even.singularValues().size(); ++i) {
-            if (sv.size() == max_dim || svd_even.singularValues()[i] / s0 < sv_cutoff) {
+        for (int i = 0; i < svalues_even.size(); ++i) {
+            if (sv.size() == max_dim || svalues_even[i] / s0 < sv_cutoff) {
                 break;
             }
-            sv.push_back(svd_even.singularValues()[i]);
-            Uvec.push_back(svd_even.matrixU().col(i));
-            Vvec.push_back(svd_even.matrixV().col(i));
-            if (sv.size() == max_dim || svd_odd.singularValues()[i] / s0 < sv_cutoff) {
+            sv.push_back(static_cast<mpreal>(svalues_even[i]));
+            Uvec.push_back(U_even.col(i));
+            Vvec.push_back(V_even.col(i));
+            if (sv.size() == max_dim || i >= svalues_odd.size() || svalues_odd[i] / s0 < sv_cutoff) {
                 break;
             }
-            sv.push_back(svd_odd.singularValues()[i]);
-            Uvec.push_back(svd_odd.matrixU().col(i));
-            Vvec.push_back(svd_odd.matrixV().col(i));
+            sv.push_back(static_cast<mpreal>(svalues_odd[i]));
+            Uvec.push_back(U_odd.col(i));
+            Vvec.push_back(V_odd.col(i));
         }
         assert(sv.size() <= max_dim);
+        U_even.resize(0, 0);
+        V_even.resize(0, 0);
+        U_odd.resize(0, 0);
+        V_odd.resize(0, 0);
 
         // Check if singular values are in decreasing order
         for (int l = 0; l < sv.size() - 1; ++l) {
@@ -303,29 +558,42 @@ namespace irlib {
         }
 
         // Construct basis functions
-        std::vector<std::vector<mpreal>> deriv_xm1 = normalized_legendre_p_derivatives(num_local_poly, mpreal("-1"));
+        detail::scoped_default_prec scoped_prec_conversion(plan.conversion);
+        const std::vector<std::vector<mpreal>> &deriv_xm1 = normalized_legendre_p_derivatives_endpoint<mpreal>(max_local_poly, -1);
         std::vector<mpreal> inv_factorial;
         inv_factorial.push_back(mpreal(1));
-        for (int l = 1; l < num_local_poly; ++l) {
+        for (int l = 1; l < max_local_poly; ++l) {
             inv_factorial.push_back(inv_factorial.back() / mpreal(l));
         }
 
-        auto gen_pp = [&](const std::vector<mpreal> &section_edges, const std::vector<vector_t> &vectors) {
+        // Index of the first Legendre coefficient of each section
+        auto gen_offset = [](const std::vector<int> &num_local_poly) {
+            std::vector<int> offset(num_local_poly.size() + 1, 0);
+            for (int s = 0; s < num_local_poly.size(); ++s) {
+                offset[s + 1] = offset[s] + num_local_poly[s];
+            }
+            return offset;
+        };
+        const std::vector<int> offset_x = gen_offset(num_local_poly_x);
+        const std::vector<int> offset_y = gen_offset(num_local_poly_y);
+
+        auto gen_pp = [&](const std::vector<mpreal> &section_edges, const std::vector<int> &num_local_poly,
+                          const std::vector<int> &offset, const std::vector<vector_t> &vectors) {
             std::vector<piecewise_polynomial<mpreal,mpreal>> pp;
 
             int ns_pp = section_edges.size() - 1;
             for (int v = 0; v < vectors.size(); ++v) {
-                Eigen::Matrix<mpreal,Eigen::Dynamic,Eigen::Dynamic> coeff(ns_pp, num_local_poly);
+                Eigen::Matrix<mpreal,Eigen::Dynamic,Eigen::Dynamic> coeff(ns_pp, max_local_poly);
                 coeff.setZero();
                 int parity = v % 2 == 0 ? 1 : -1;
                 // loop over sections in [0, 1]
                 for (int s = 0; s < section_edges.size() - 1; ++s) {
                     // loop over normalized Legendre polynomials
-                    for (int l = 0; l < num_local_poly; ++l) {
+                    for (int l = 0; l < num_local_poly[s]; ++l) {
                         mpreal coeff2 = mpreal(1)/mpfr::sqrt(section_edges[s + 1] - section_edges[s]);
                         // loop over the orders of derivatives
-                        for (int d = 0; d < num_local_poly; ++d) {
-                            mpreal tmp = inv_factorial[d] * coeff2 * vectors[v][s * num_local_poly + l] * deriv_xm1[l][d];
+                        for (int d = 0; d < num_local_poly[s]; ++d) {
+                            mpreal tmp = inv_factorial[d] * coeff2 * static_cast<mpreal>(vectors[v][offset[s] + l]) * deriv_xm1[l][d];
                             coeff(s, d) += tmp;
                             coeff2 *= mpreal(2)/(section_edges[s + 1] - section_edges[s]);
                         }
@@ -337,8 +605,8 @@ namespace irlib {
             return pp;
         };
 
-        auto u_basis_pp = gen_pp(section_edges_x, Uvec);
-        auto v_basis_pp = gen_pp(section_edges_y, Vvec);
+        auto u_basis_pp = gen_pp(section_edges_x, num_local_poly_x, offset_x, Uvec);
+        auto v_basis_pp = gen_pp(section_edges_y, num_local_poly_y, offset_y, Vvec);
 
         for (int i = 0; i < u_basis_pp.size(); ++i) {
             if (u_basis_pp[i].compute_value(1) < 0) {
@@ -347,14 +615,19 @@ namespace irlib {
             }
         }
 
+        detail::scoped_default_prec scoped_prec_residual(plan.residual);
         if (u_basis_pp.size()%2 == 1) {
-            r_int_eq.first = estimate_residual(u_basis_pp.back(), v_basis_pp.back(), sv.back(), kernel_even, num_nodes_gauss_legendre);
-            auto k_yx = [&](mpreal y, mpreal x) {return kernel_even(x,y);};
-            r_int_eq.second = estimate_residual(v_basis_pp.back(), u_basis_pp.back(), sv.back(), k_yx, num_nodes_gauss_legendre);
+            r_int_eq.first = estimate_residual(u_basis_pp.back(), v_basis_pp.back(), sv.back(), kernel_even, num_nodes_gauss_legendre,
+                                                num_threads);
+            r_int_eq.second = estimate_residual(v_basis_pp.back(), u_basis_pp.back(), sv.back(),
+                                                detail::transposed_kernel<detail::symmetrized_kernel<KernelType>>(kernel_even), num_nodes_gauss_legendre,
+                                                num_threads);
         } else {
-            r_int_eq.first = estimate_residual(u_basis_pp.back(), v_basis_pp.back(), sv.back(), kernel_odd, num_nodes_gauss_legendre);
-            auto k_yx = [&](mpreal y, mpreal x) {return kernel_odd(x,y);};
-            r_int_eq.second = estimate_residual(v_basis_pp.back(), u_basis_pp.back(), sv.back(), k_yx, num_nodes_gauss_legendre);
+            r_int_eq.first = estimate_residual(u_basis_pp.back(), v_basis_pp.back(), sv.back(), kernel_odd, num_nodes_gauss_legendre,
+                                                num_threads);
+            r_int_eq.second = estimate_residual(v_basis_pp.back(), u_basis_pp.back(), sv.back(),
+                                                detail::transposed_kernel<detail::symmetrized_kernel<KernelType>>(kernel_odd), num_nodes_gauss_legendre,
+                                                num_threads);
         }
 
 
@@ -367,19 +640,41 @@ namespace irlib {
             auto l = Uvec.size() -1;
             for (int s = 0; s < residual_x.size(); ++s) {
                 double dx = static_cast<double>(section_edges_x[s+1]-section_edges_x[s]);
-                double a_diff = static_cast<double>(Uvec[l](s * num_local_poly + num_local_poly - 1)) * std::sqrt((2.*l+1)/dx);
+                double a_diff = static_cast<double>(Uvec[l](offset_x[s + 1] - 1)) * std::sqrt((2.*l+1)/dx);
                 residual_x[s] = std::abs(a_diff);
             }
             for (int s = 0; s < residual_y.size(); ++s) {
                 double dy = static_cast<double>(section_edges_y[s+1]-section_edges_y[s]);
-                double a_diff = static_cast<double>(Vvec[l](s * num_local_poly + num_local_poly - 1)) * std::sqrt((2.*l+1)/dy);
+                double a_diff = static_cast<double>(Vvec[l](offset_y[s + 1] - 1)) * std::sqrt((2.*l+1)/dy);
                 residual_y[s] = std::abs(a_diff);
             }
         }
 
+        // Decay rate of the Legendre coefficients estimated from the last four coefficients.
+        // Taking the maximum over pairs of neighboring orders avoids accidentally small coefficients of one parity.
+        auto gen_decay = [](const vector_t &vec, const std::vector<int> &offset, std::vector<double> &decay) {
+            decay.resize(offset.size() - 1);
+            for (int s = 0; s < decay.size(); ++s) {
+                const int end = offset[s + 1];
+                if (end - offset[s] < 4) {
+                    decay[s] = 1.0;
+                    continue;
+                }
+                const double tail = std::max(std::abs(static_cast<double>(vec(end - 1))), std::abs(static_cast<double>(vec(end - 2))));
+                const double head = std::max(std::abs(static_cast<double>(vec(end - 3))), std::abs(static_cast<double>(vec(end - 4))));
+                decay[s] = head > 0.0 ? std::min(1.0, std::sqrt(tail / head)) : 1.0;
+            }
+        };
+        gen_decay(Uvec.back(), offset_x, decay_x);
+        gen_decay(Vvec.back(), offset_y, decay_y);
+
         return std::make_tuple(sv, u_basis_pp, v_basis_pp);
     }
 
+    template<typename Kernel>
+    std::pair<std::vector<double>,std::vector<double>>
+    compute_approximate_nodes_even_sector(const Kernel &knl, int N, double cutoff_singular_values);
+
     template<typename ScalarType, typename KernelType>
     std::tuple<
             std::vector<mpreal>,
@@ -393,14 +688,19 @@ namespace irlib {
             bool verbose = false,
             double r_tol = 1e-6,
             int num_local_poly = 10,
-            int num_nodes_gauss_legendre = 24
+            int num_nodes_gauss_legendre = 24,
+            const precision_plan &plan = precision_plan(),
+            int max_local_poly = 0,
+            double compression_tol = 0,
+            int num_threads = 0
     ) throw(std::runtime_error) {
         using vector_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, 1>;
+        max_local_poly = std::max(max_local_poly, num_local_poly);
         // Compute approximate positions of nodes of the highest basis function in the even sector
         std::vector<double> nodes_x, nodes_y;
         if (verbose){
             std::cout << "Computing approximate positions of zeros... ";
-            std::tie(nodes_x, nodes_y) = compute_approximate_nodes_even_sector(kernel, 500, std::max(1e-12, sv_cutoff));
+            std::tie(nodes_x, nodes_y) = compute_approximate_nodes_even_sector(kernel, 100, std::max(1e-12, sv_cutoff));
             std::cout << "Done" << std::endl;
         }
 
@@ -414,41 +714,76 @@ namespace irlib {
             return section_edges;
         };
 
-        auto u = [](const std::vector<mpreal> &section_edges,
-                    std::vector<double> &residual, double eps) {
-            std::vector<mpreal> section_edges_new(section_edges);
-            for (int s = 0; s < section_edges.size() - 1; ++s) {
-                if (residual[s] > eps) {
-                    section_edges_new.push_back(
-                            (section_edges[s] + section_edges[s + 1]) / 2
-                    );
+        // A section with a too large residual gets more Legendre polynomials if its coefficients decay fast enough
+        // that fewer than num_local_poly of them are needed to reach eps (and the order stays within max_local_poly).
+        // Otherwise, only the section at x, y = 1, where the basis functions have a boundary layer of width ~ 1/Lambda,
+        // is bisected, and both halves start again from num_local_poly. Bisection thus builds a mesh that is geometrically
+        // graded towards the end point. Other sections get two more Legendre polynomials,
+        // and are bisected only when they reach max_local_poly.
+        auto u = [&](std::vector<mpreal> &section_edges, std::vector<int> &num_local_poly_sec,
+                     const std::vector<double> &residual, const std::vector<double> &decay, double eps) {
+            std::vector<mpreal> section_edges_new;
+            std::vector<int> num_local_poly_new;
+            const int num_sec = section_edges.size() - 1;
+            for (int s = 0; s < num_sec; ++s) {
+                section_edges_new.push_back(section_edges[s]);
+                if (residual[s] <= eps) {
+                    num_local_poly_new.push_back(num_local_poly_sec[s]);
+                    continue;
                 }
+                if (decay[s] < 1.0) {
+                    const int num_extra = decay[s] > 0.0 ?
+                            std::max(2, static_cast<int>(std::ceil(std::log(eps / residual[s]) / std::log(decay[s])))) : 2;
+                    if (num_extra < num_local_poly && num_local_poly_sec[s] + num_extra <= max_local_poly) {
+                        num_local_poly_new.push_back(num_local_poly_sec[s] + num_extra);
+                        continue;
+                    }
+                }
+                if (s < num_sec - 1 && num_local_poly_sec[s] + 2 <= max_local_poly) {
+                    num_local_poly_new.push_back(num_local_poly_sec[s] + 2);
+                    continue;
+                }
+                num_local_poly_new.push_back(num_local_poly);
+                section_edges_new.push_back((section_edges[s] + section_edges[s + 1]) / 2);
+                num_local_poly_new.push_back(num_local_poly);
             }
-            std::sort(section_edges_new.begin(), section_edges_new.end());
-            return section_edges_new;
+            section_edges_new.push_back(section_edges.back());
+            const bool changed = section_edges_new.size() != section_edges.size() || num_local_poly_new != num_local_poly_sec;
+            section_edges.swap(section_edges_new);
+            num_local_poly_sec.swap(num_local_poly_new);
+            return changed;
         };
 
         std::vector<mpreal> section_edges_x = gen_section_edges(nodes_x);
         std::vector<mpreal> section_edges_y = gen_section_edges(nodes_y);
+        std::vector<int> num_local_poly_x(section_edges_x.size() - 1, num_local_poly);
+        std::vector<int> num_local_poly_y(section_edges_y.size() - 1, num_local_poly);
 
         int ite = 0;
 
-        // Sections are split recursively until convergence is reached.
+        // Sections are refined recursively until convergence is reached.
         while (true) {
             if (verbose) {
-                std::cout << "Iteration " << ite+1 << " : " << section_edges_x.size()-1 << " sections for x, " << section_edges_y.size()-1 << " sections for y." << std::endl;
+                std::cout << "Iteration " << ite+1 << " : " << section_edges_x.size()-1 << " sections for x, " << section_edges_y.size()-1 << " sections for y"
+                          << " (matrix dimension " << std::accumulate(num_local_poly_x.begin(), num_local_poly_x.end(), 0)
+                          << " x " << std::accumulate(num_local_poly_y.begin(), num_local_poly_y.end(), 0) << ")." << std::endl;
             }
-            std::vector<double> residual_x, residual_y;
+            std::vector<double> residual_x, residual_y, decay_x, decay_y;
             std::pair<double,double> r_int_eq;
-            auto r = generate_ir_basis_functions_impl<ScalarType>(kernel, max_dim, sv_cutoff, num_local_poly, num_nodes_gauss_legendre,
+            auto r = generate_ir_basis_functions_impl<ScalarType>(kernel, max_dim, sv_cutoff,
+                    num_local_poly_x, num_local_poly_y, num_local_poly, num_nodes_gauss_legendre,
                     section_edges_x,
                     section_edges_y,
                     residual_x,
                     residual_y,
+                    decay_x,
+                    decay_y,
                     r_int_eq,
-                    verbose
+                    verbose,
+                    plan,
+                    compression_tol,
+                    num_threads
             );
-            int ns = section_edges_x.size() + section_edges_y.size();
 
             int dim = std::get<1>(r).size();
 
@@ -460,8 +795,8 @@ namespace irlib {
                     std::abs(static_cast<double>(std::get<2>(r)[2*(dim/2)-1].compute_value(0)))
             );
 
-            section_edges_x = u(section_edges_x, residual_x, a_tol_x);
-            section_edges_y = u(section_edges_y, residual_y, a_tol_y);
+            const bool changed_x = u(section_edges_x, num_local_poly_x, residual_x, decay_x, a_tol_x);
+            const bool changed_y = u(section_edges_y, num_local_poly_y, residual_y, decay_y, a_tol_y);
 
             if (verbose) {
                 std::cout << "Iteration " << ite+1 << " : found " << std::get<1>(r).size() <<  " basis functions. " << std::endl;
@@ -469,9 +804,10 @@ namespace irlib {
                 std::cout << "Iteration " << ite+1 << " : max_y |v_l(y) - s_l^{-1} dx int_{-1}^1 K(x,y) u_l(x)| = " << r_int_eq.second << " for largest l." << std::endl;
                 std::cout << "Iteration " << ite+1 << " : residual estimated by expansion coefficients for x = " << *std::max_element(residual_x.begin(),residual_x.end()) << std::endl;
                 std::cout << "Iteration " << ite+1 << " : residual estimated by expansion coefficients for y = " << *std::max_element(residual_y.begin(),residual_y.end()) << std::endl;
+                std::cout << "Iteration " << ite+1 << " : peak memory usage = " << detail::peak_memory_usage() / (1024 * 1024) << " MB" << std::endl;
             }
 
-            if (section_edges_x.size() + section_edges_y.size() == ns) {
+            if (!changed_x && !changed_y) {
                 return r;
             }
 
@@ -514,7 +850,224 @@ namespace irlib {
     };
 
     /**
-     * Find all zeros of a piecewise polynomial defined on (0,1)
+     * Construct cubic spline interpolations of many functions sampled on the same grid.
+     * The tridiagonal system depends only on the grid, so it is factorized only once.
+     * @param x_array grid points
+     * @param y_arrays values of the functions on the grid [function][point]
+     * @return piecewise polynomials
+     */
+    template<typename T>
+    std::vector<piecewise_polynomial<T,T>> construct_piecewise_polynomial_cspline(
+            const std::vector<T> &x_array, const std::vector<std::vector<T>> &y_arrays) {
+        const int n_points = x_array.size();
+        const int n_section = n_points - 1;
+
+        tk::spline_set<T> splines;
+        splines.set_points(x_array, y_arrays);
+
+        std::vector<piecewise_polynomial<T,T>> pps;
+        Eigen::Matrix<T,Eigen::Dynamic,Eigen::Dynamic> coeff(n_section, 4);
+        for (int f = 0; f < y_arrays.size(); ++f) {
+            for (int s = 0; s < n_section; ++s) {
+                for (int p = 0; p < 4; ++p) {
+                    coeff(s, p) = splines.get_coeff(f, s, p);
+                }
+            }
+            pps.push_back(piecewise_polynomial<T,T>(n_section, x_array, coeff));
+        }
+        return pps;
+    };
+
+    namespace detail {
+        /// Evaluate sum_p c[p] t^p and its first derivative by Horner's scheme
+        template<typename T>
+        void horner(const std::vector<T> &c, const T &t, T &val, T &deriv) {
+            val = c.back();
+            deriv = 0.0;
+            for (int p = c.size() - 2; p >= 0; --p) {
+                deriv = deriv * t + val;
+                val = val * t + c[p];
+            }
+        }
+
+        template<typename T>
+        T horner(const std::vector<T> &c, const T &t) {
+            T val, deriv;
+            horner(c, t, val, deriv);
+            return val;
+        }
+
+        template<typename T>
+        int sign(const T &x) {
+            return x > 0 ? 1 : (x < 0 ? -1 : 0);
+        }
+
+        /**
+         * Upper bound on the number of roots of sum_p c[p] t^p in the open interval (a, b)
+         * by Descartes' rule of signs applied to (1+u)^k p(a + (b-a) u/(1+u)).
+         * The bound is exact when it is 0 or 1.
+         */
+        template<typename T>
+        int descartes_bound(const std::vector<T> &c, const T &a, const T &b) {
+            const int k = c.size() - 1;
+
+            // Taylor shift to a and scale by b-a
+            std::vector<T> d(c);
+            for (int i = 0; i < k; ++i) {
+                for (int p = k - 1; p >= i; --p) {
+                    d[p] += a * d[p + 1];
+                }
+            }
+            T h_pow = 1.0;
+            for (int p = 0; p <= k; ++p) {
+                d[p] *= h_pow;
+                h_pow *= (b - a);
+            }
+
+            // q(u) = sum_p d[p] u^p (1+u)^{k-p}
+            std::vector<T> q(k + 1, T(0.0)), binom(k + 1);
+            for (int p = 0; p <= k; ++p) {
+                binom[0] = 1.0;
+                for (int j = 1; j <= k - p; ++j) {
+                    binom[j] = binom[j - 1] * T(k - p - j + 1) / T(j);
+                }
+                for (int j = 0; j <= k - p; ++j) {
+                    q[p + j] += d[p] * binom[j];
+                }
+            }
+
+            int num_changes = 0, last_sign = 0;
+            for (int p = 0; p <= k; ++p) {
+                int sign_p = sign(q[p]);
+                if (sign_p != 0) {
+                    if (last_sign != 0 && sign_p != last_sign) {
+                        ++num_changes;
+                    }
+                    last_sign = sign_p;
+                }
+            }
+            return num_changes;
+        }
+
+        /// Polish a root bracketed by [a, b] by Newton's method safeguarded by bisection
+        template<typename T>
+        T polish_root(const std::vector<T> &c, T a, T b, const T &delta) {
+            const int max_iter = 1000;
+            int sign_a = sign(horner(c, a));
+
+            T x = (a + b) / 2;
+            for (int iter = 0; iter < max_iter; ++iter) {
+                T val, deriv;
+                horner(c, x, val, deriv);
+                if (val == 0) {
+                    return x;
+                }
+                if (sign(val) == sign_a) {
+                    a = x;
+                } else {
+                    b = x;
+                }
+                T x_new = (deriv != 0) ? x - val / deriv : (a + b) / 2;
+                if (!(x_new > a && x_new < b)) {
+                    x_new = (a + b) / 2;
+                }
+                if (abs(x_new - x) < delta || b - a < delta) {
+                    return x_new;
+                }
+                x = x_new;
+            }
+            return x;
+        }
+
+        /**
+         * Find all real roots of sum_p c[p] t^p in the open interval (a, b).
+         * Roots are isolated with Descartes' rule of signs, or otherwise between successive critical points,
+         * and then polished by safeguarded Newton iterations.
+         */
+        template<typename T>
+        void polynomial_roots(std::vector<T> c, const T &a, const T &b, const T &delta, std::vector<T> &roots) {
+            while (c.size() > 1 && c.back() == 0) {
+                c.pop_back();
+            }
+            if (c.size() < 2) {
+                return;
+            }
+
+            int bound = descartes_bound(c, a, b);
+            if (bound == 0) {
+                return;
+            }
+            if (bound == 1 && sign(horner(c, a)) * sign(horner(c, b)) < 0) {
+                roots.push_back(polish_root(c, a, b, delta));
+                return;
+            }
+
+            // Otherwise, the polynomial is monotonic between two successive critical points.
+            std::vector<T> c_deriv(c.size() - 1);
+            for (int p = 0; p < c_deriv.size(); ++p) {
+                c_deriv[p] = T(p + 1) * c[p + 1];
+            }
+            std::vector<T> points;
+            points.push_back(a);
+            polynomial_roots(c_deriv, a, b, delta, points);
+            points.push_back(b);
+
+            for (int i = 0; i < points.size() - 1; ++i) {
+                T v_left = horner(c, points[i]), v_right = horner(c, points[i + 1]);
+                if (i > 0 && v_left == 0) {
+                    roots.push_back(points[i]);
+                } else if (sign(v_left) * sign(v_right) < 0) {
+                    roots.push_back(polish_root(c, points[i], points[i + 1], delta));
+                }
+            }
+        }
+
+        /**
+         * Find all real roots of a piecewise polynomial by solving the local polynomial in each section.
+         * Sign changes across section edges are also detected.
+         */
+        template<typename T, typename Tx>
+        std::vector<Tx> piecewise_polynomial_roots(const std::vector<Tx> &section_edges,
+                                                   const std::vector<std::vector<T> > &coeffs,
+                                                   Tx delta) {
+            const int n_section = section_edges.size() - 1;
+            const T delta_T = static_cast<T>(delta);
+
+            std::vector<Tx> zeros;
+            std::vector<T> local_roots;
+            for (int s = 0; s < n_section; ++s) {
+                const T h = static_cast<T>(section_edges[s + 1] - section_edges[s]);
+
+                local_roots.clear();
+                polynomial_roots(coeffs[s], T(0.0), h, delta_T, local_roots);
+                for (const auto &t : local_roots) {
+                    zeros.push_back(section_edges[s] + static_cast<Tx>(t));
+                }
+
+                if (s < n_section - 1) {
+                    int sign_left = sign(horner(coeffs[s], h)), sign_right = sign(coeffs[s + 1][0]);
+                    if (sign_left * sign_right <= 0) {
+                        zeros.push_back(section_edges[s + 1]);
+                    }
+                }
+            }
+
+            // remove duplicates found on both sides of a section edge
+            std::sort(zeros.begin(), zeros.end());
+            std::vector<Tx> zeros_unique;
+            for (const auto &x : zeros) {
+                if (zeros_unique.empty() || x - zeros_unique.back() > delta) {
+                    zeros_unique.push_back(x);
+                }
+            }
+            return zeros_unique;
+        }
+    }
+
+    /**
+     * Find all zeros of a piecewise polynomial in the interior of its domain.
+     * All real roots of the local polynomial are computed section by section,
+     * thus the cost is linear in the number of sections.
      * @tparam T
      * @tparam Tx
      * @param p
@@ -526,36 +1079,37 @@ namespace irlib {
             const piecewise_polynomial<T,Tx>& p,
             Tx delta
     ) {
-        int N = 10000;
-        Tx de_cutoff = 3.0;
-
-        std::vector<Tx> tx_vec = linspace<Tx>(0.0, de_cutoff, N);
-        std::vector<Tx> x_vec(N), zeros;
-        for (int i = 0; i < N; ++i) {
-            x_vec[i] = tanh(0.5 * const_pi<Tx>() * sinh(tx_vec[i]));
+        std::vector<std::vector<T> > coeffs(p.num_sections(), std::vector<T>(p.order() + 1));
+        for (int s = 0; s < p.num_sections(); ++s) {
+            for (int k = 0; k < p.order() + 1; ++k) {
+                coeffs[s][k] = p.coefficient(s, k);
+            }
         }
+        return detail::piecewise_polynomial_roots(p.section_edges(), coeffs, delta);
+    };
 
-        for (int i = 0; i < N-1; ++i) {
-            if (p.compute_value(x_vec[i]) * p.compute_value(x_vec[i+1]) < 0) {
-                Tx x_left = x_vec[i];
-                T p_left = p.compute_value(x_vec[i]);
-
-                Tx x_right = x_vec[i+1];
-                T p_right = p.compute_value(x_vec[i+1]);
-
-                while (x_right-x_left > delta) {
-                    Tx x_mid = (x_left+x_right)/2;
-                    if (p_left * p.compute_value(x_mid) > 0) {
-                        x_left = x_mid;
-                    } else {
-                        x_right = x_mid;
-                    }
-                }
-                zeros.push_back((x_left+x_right)/2);
+    /**
+     * Find all local extrema (zeros of the first derivative) of a piecewise polynomial
+     * in the interior of its domain.
+     * @tparam T
+     * @tparam Tx
+     * @param p
+     * @param delta tolerance
+     * @return
+     */
+    template<typename T, typename Tx>
+    std::vector<Tx> find_extrema(
+            const piecewise_polynomial<T,Tx>& p,
+            Tx delta
+    ) {
+        const int k = std::max(p.order(), 1);
+        std::vector<std::vector<T> > coeffs(p.num_sections(), std::vector<T>(k, T(0.0)));
+        for (int s = 0; s < p.num_sections(); ++s) {
+            for (int i = 0; i < p.order(); ++i) {
+                coeffs[s][i] = T(i + 1) * p.coefficient(s, i + 1);
             }
         }
-
-        return zeros;
+        return detail::piecewise_polynomial_roots(p.section_edges(), coeffs, delta);
     };
 
     template<typename T, typename Tx>
@@ -605,14 +1159,14 @@ namespace irlib {
 
         int Nx = x.size();
 
-        // construct cspline approximation one by one
+        // construct cspline approximations of all basis functions at once
+        std::vector<std::vector<T>> ys(basis_vectors.size(), std::vector<T>(Nx));
         for (int l=0; l < basis_vectors.size(); ++l) {
             for (int ix=0; ix<Nx; ++ix) {
-                //std::cout << " final x " << std::setprecision(20) << x[ix] << std::endl;
-                y[ix] = basis_vectors[l].compute_value(x[ix]);
+                ys[l][ix] = basis_vectors[l].compute_value(x[ix]);
             }
-            basis_vectors_cspline.push_back(construct_piecewise_polynomial_cspline<T>(x, y));
         }
+        basis_vectors_cspline = construct_piecewise_polynomial_cspline<T>(x, ys);
 
         return basis_vectors_cspline;
     };
@@ -1009,23 +1563,25 @@ namespace irlib {
 
 
     /**
-     * Find approximate positions of nodes for the even singular vectors with the lowest singular value larger than a cutoff
+     * Discretize the kernel in the even sector on double-exponential (DE) meshes of N points for x in [0, 1) and y in (0, 1].
+     * K(i, j) = sqrt(w_x[i]) * (K(x_i, y_j) + K(x_i, -y_j)) * sqrt(w_y[j]), so that the singular vectors of K
+     * approximate those of the kernel (multiplied by the square roots of the weights) at the mesh points.
      * @tparam Kernel kernel type
      * @param knl Kernel object
-     * @param N Number of points for discretizing the kernel
-     * @param cutoff_singular_values smallest relative singular value
-     * @return positions of nodes
+     * @param N number of points
+     * @param x_vec mesh points for x in ascending order
+     * @param y_vec mesh points for y in ascending order
+     * @return kernel matrix (N x N)
      */
     template<typename Kernel>
-    std::pair<std::vector<double>,std::vector<double>>
-    compute_approximate_nodes_even_sector(const Kernel &knl, int N, double cutoff_singular_values) {
-        typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
-
-        double de_cutoff = 2.5;
+    Eigen::MatrixXd
+    de_mesh_kernel_matrix_even_sector(const Kernel &knl, int N, std::vector<double> &x_vec, std::vector<double> &y_vec) {
+        const double de_cutoff = 2.5;
 
         //DE mesh for x
         std::vector<double> tx_vec = linspace<double>(0.0, de_cutoff, N);
-        std::vector<double> weight_x(N), x_vec(N);
+        std::vector<double> weight_x(N);
+        x_vec.resize(N);
         for (int i = 0; i < N; ++i) {
             x_vec[i] = std::tanh(0.5 * M_PI * std::sinh(tx_vec[i]));
             //sqrt of the weight of DE formula
@@ -1035,7 +1591,8 @@ namespace irlib {
 
         //DE mesh for y
         std::vector<double> ty_vec = linspace<double>(-de_cutoff, 0.0, N);
-        std::vector<double> y_vec(N), weight_y(N);
+        std::vector<double> weight_y(N);
+        y_vec.resize(N);
         for (int i = 0; i < N; ++i) {
             y_vec[i] = std::tanh(0.5 * M_PI * std::sinh(ty_vec[i])) + 1.0;
             //sqrt of the weight of DE formula
@@ -1043,50 +1600,94 @@ namespace irlib {
                     std::sqrt(0.5 * M_PI * std::cosh(ty_vec[i])) / std::cosh(0.5 * M_PI * std::sinh(ty_vec[i]));
         }
 
-        matrix_t K(N, N);
+        Eigen::MatrixXd K(N, N);
         for (int i = 0; i < N; ++i) {
             for (int j = 0; j < N; ++j) {
                 K(i, j) = weight_x[i] * static_cast<double>(knl(x_vec[i], y_vec[j]) + knl(x_vec[i], -y_vec[j])) *
                           weight_y[j];
             }
         }
+        return K;
+    }
+
+    /**
+     * Find approximate positions of nodes for the even singular vectors with the lowest singular value larger than a cutoff
+     * Only the leading singular triplets are computed (see detail::truncated_svd).
+     * The number of points is increased until there are at least min_points_per_node points per node.
+     * @tparam Kernel kernel type
+     * @param knl Kernel object
+     * @param N Minimum number of points for discretizing the kernel
+     * @param cutoff_singular_values smallest relative singular value
+     * @return positions of nodes
+     */
+    template<typename Kernel>
+    std::pair<std::vector<double>,std::vector<double>>
+    compute_approximate_nodes_even_sector(const Kernel &knl, int N, double cutoff_singular_values) {
+        typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
 
-        //Perform SVD
-        Eigen::BDCSVD<matrix_t> svd(K, Eigen::ComputeFullU | Eigen::ComputeFullV);
-        const Eigen::VectorXd& svalues = svd.singularValues();
-        const matrix_t& U = svd.matrixU();
-        const matrix_t& V = svd.matrixV();
+        const int min_points_per_node = 8;
+        const int oversampling = 8;
+        const int num_power_iterations = 4;
+        const int max_refinements = 3;
 
-        //Count non-zero SV
-        int dim = N;
-        for (int i = 1; i < N; ++i) {
-            if (std::abs(svalues(i) / svalues(0)) < cutoff_singular_values) {
-                dim = i;
-                break;
+        int num_refinements = 0;
+        while (true) {
+            std::vector<double> x_vec, y_vec;
+            const matrix_t K = de_mesh_kernel_matrix_even_sector(knl, N, x_vec, y_vec);
+
+            //Perform truncated SVD. The rank is increased until a singular value below the cutoff is found.
+            Eigen::VectorXd svalues;
+            matrix_t U, V;
+            int rank = std::min(N, 16);
+            int dim;
+            while (true) {
+                detail::truncated_svd(K, rank, num_power_iterations, svalues, U, V);
+
+                //Count non-zero SV
+                dim = rank;
+                for (int i = 1; i < rank; ++i) {
+                    if (std::abs(svalues(i) / svalues(0)) < cutoff_singular_values) {
+                        dim = i;
+                        break;
+                    }
+                }
+                if (dim + oversampling <= rank || rank == N) {
+                    break;
+                }
+                rank = std::min(N, std::max(2 * rank, dim + oversampling));
             }
-        }
 
-        //find nodes
-        std::vector<double> nodes_x, nodes_y;
-        for (int i = 0; i < N - 1; ++i) {
-            if (U(i, dim - 1) * U(i + 1, dim - 1) < 0.0) {
-                nodes_x.push_back(0.5 * (x_vec[i] + x_vec[i + 1]));
+            if (N < min_points_per_node * dim) {
+                N = min_points_per_node * dim;
+                continue;
+            }
+
+            //find nodes
+            std::vector<double> nodes_x, nodes_y;
+            for (int i = 0; i < N - 1; ++i) {
+                if (U(i, dim - 1) * U(i + 1, dim - 1) < 0.0) {
+                    nodes_x.push_back(0.5 * (x_vec[i] + x_vec[i + 1]));
+                }
+                if (V(i, dim - 1) * V(i+1, dim - 1) < 0.0) {
+                    nodes_y.push_back(0.5 * (y_vec[i] + y_vec[i + 1]));
+                }
             }
-            if (V(i, dim - 1) * V(i+1, dim - 1) < 0.0) {
-                nodes_y.push_back(0.5 * (y_vec[i] + y_vec[i + 1]));
+
+            if (nodes_x.size() == dim - 1 && nodes_y.size() == dim - 1) {
+                return std::make_pair(nodes_x, nodes_y);
             }
-        }
 
-        if (nodes_x.size() != dim - 1 || nodes_y.size() != dim - 1) {
-            std::cerr << "The number of nodes for x is " << nodes_x.size() << " , which is different from l " << dim-1 << std::endl;
-            std::cerr << "The number of nodes for y is " << nodes_y.size() << " , which is different from l " << dim-1 << std::endl;
-            for (auto n : nodes_y) {
-                std::cout << n << std::endl;
+            if (num_refinements == max_refinements) {
+                std::cerr << "The number of nodes for x is " << nodes_x.size() << " , which is different from l " << dim-1 << std::endl;
+                std::cerr << "The number of nodes for y is " << nodes_y.size() << " , which is different from l " << dim-1 << std::endl;
+                for (auto n : nodes_y) {
+                    std::cout << n << std::endl;
+                }
+                throw std::runtime_error("The number of nodes is wrong.");
             }
-            throw std::runtime_error("The number of nodes is wrong.");
+            N *= 2;
+            ++num_refinements;
         }
-
-        return std::make_pair(nodes_x, nodes_y);
     }
 
 /**
@@ -1102,7 +1703,7 @@ namespace irlib {
         mpfr::mpreal::set_default_prec(mpfr::digits2bits(digits));
 
         int num_local_nodes = 24;
-        auto local_nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
+        const auto &local_nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
         std::vector<mpreal> section_edges = p.section_edges();
         auto global_nodes = composite_gauss_legendre_nodes(section_edges, local_nodes);
         auto n_local_nodes = local_nodes.size();
@@ -1200,7 +1801,7 @@ namespace irlib {
         auto prec_bak = mpfr::mpreal::get_default_prec();
 
         int num_local_nodes = 24;
-        auto local_nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
+        const auto &local_nodes = detail::gauss_legendre_nodes<mpreal>(num_local_nodes);
         std::vector<mpreal> section_edges = p.section_edges();
         auto global_nodes = composite_gauss_legendre_nodes(section_edges, local_nodes);
         auto n_local_nodes = local_nodes.size();
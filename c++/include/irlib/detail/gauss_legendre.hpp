@@ -26,9 +26,10 @@ inline mpfr::mpreal stoscalar<mpfr::mpreal>(const std::string& s) {
    return mpfr::mpreal(s);
 }
 
+/// Parse the hardcoded Gauss-Legendre nodes and weights. Use gauss_legendre_nodes(), which caches the results.
 template<typename T>
 std::vector<std::pair<T,T>>
-gauss_legendre_nodes(int num_nodes) {
+gauss_legendre_nodes_table(int num_nodes) {
 
 
     if (num_nodes == 6) {
@@ -457,7 +458,7 @@ gauss_legendre_nodes(int num_nodes) {
     }
 
 
-    throw std::runtime_error("Invalid num_nodes passed to gauss_legendre_nodes");
+    throw std::runtime_error("Invalid num_nodes passed to gauss_legendre_nodes_table");
 }
 
 }
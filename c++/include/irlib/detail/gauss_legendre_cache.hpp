@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <mpreal.h>
+
+#include "gauss_legendre.hpp"
+
+namespace irlib {
+namespace detail {
+
+/// Precision used as a part of cache keys. Hardware types have a fixed precision.
+template<typename T>
+struct scalar_precision {
+    static long get() {
+        return 0;
+    }
+};
+
+template<>
+struct scalar_precision<mpfr::mpreal> {
+    static long get() {
+        return mpfr::mpreal::get_default_prec();
+    }
+};
+
+/**
+ * Compute Gauss-Legendre nodes and weights on [-1, 1] for any number of nodes at the current default precision.
+ * The roots of P_n(x) are located by Newton's method starting from the asymptotic initial guesses
+ * x_i ~ cos(pi (i + 3/4) / (n + 1/2)), with P_n and P'_n evaluated by the three-term recurrence.
+ * Nodes are ordered as in the hardcoded tables: +x_0, -x_0, +x_1, -x_1, ... (0 comes last for odd n).
+ * @param num_nodes number of nodes
+ * @return pairs of nodes and weights
+ */
+template<typename T>
+std::vector<std::pair<T,T>>
+gauss_legendre_nodes_newton(int num_nodes) {
+    using std::abs;
+    using std::atan;
+    using std::cos;
+
+    if (num_nodes < 1) {
+        throw std::runtime_error("Invalid num_nodes passed to gauss_legendre_nodes_newton");
+    }
+
+    const T one(1), two(2);
+    const T pi = 4 * atan(one);
+    const T eps = std::numeric_limits<T>::epsilon();
+    const int max_iter = 100;
+
+    // Value of P_n and its derivative at x
+    auto legendre = [&](const T &x, T &pn, T &dpn) {
+        T p0 = one, p1 = x;
+        for (int l = 1; l < num_nodes; ++l) {
+            T p2 = ((2 * l + 1) * x * p1 - l * p0) / (l + 1);
+            p0 = p1;
+            p1 = p2;
+        }
+        pn = p1;
+        dpn = num_nodes * (x * p1 - p0) / (x * x - one);
+    };
+
+    std::vector<std::pair<T,T>> nodes(num_nodes);
+    for (int i = 0; i < num_nodes / 2; ++i) {
+        T x = cos(pi * (i + T(0.75)) / (num_nodes + T(0.5)));
+        T pn, dpn;
+        for (int iter = 0; iter < max_iter; ++iter) {
+            legendre(x, pn, dpn);
+            T dx = pn / dpn;
+            x -= dx;
+            if (abs(dx) <= 4 * eps * abs(x)) {
+                break;
+            }
+        }
+        legendre(x, pn, dpn);
+        T w = two / ((one - x * x) * dpn * dpn);
+        nodes[2 * i] = std::make_pair(x, w);
+        nodes[2 * i + 1] = std::make_pair(-x, w);
+    }
+    if (num_nodes % 2 == 1) {
+        // P'_n(0) = n P_{n-1}(0)
+        T x(0), dpn;
+        T p0 = one, p1 = x;
+        for (int l = 1; l < num_nodes - 1; ++l) {
+            T p2 = ((2 * l + 1) * x * p1 - l * p0) / (l + 1);
+            p0 = p1;
+            p1 = p2;
+        }
+        dpn = num_nodes * (num_nodes == 1 ? one : p1);
+        nodes[num_nodes - 1] = std::make_pair(x, two / (dpn * dpn));
+    }
+    return nodes;
+}
+
+/// Whether the hardcoded table (300 significant digits) is available and accurate enough
+template<typename T>
+bool gauss_legendre_table_available(int num_nodes) {
+    const bool tabulated = num_nodes == 6 || num_nodes == 12 || num_nodes == 24 || num_nodes == 48
+                           || num_nodes == 96 || num_nodes == 192;
+    return tabulated && scalar_precision<T>::get() <= static_cast<long>(mpfr::digits2bits(300));
+}
+
+/**
+ * Return Gauss-Legendre nodes and weights on [-1, 1].
+ * The nodes are taken from the hardcoded tables if available, and computed by gauss_legendre_nodes_newton() otherwise.
+ * They are computed once per (type, number of nodes, default precision) in a process
+ * and stored in a thread-safe cache. The returned reference stays valid until the end of the process.
+ * @param num_nodes number of nodes
+ * @return pairs of nodes and weights
+ */
+template<typename T>
+const std::vector<std::pair<T,T>> &
+gauss_legendre_nodes(int num_nodes) {
+    typedef std::vector<std::pair<T,T>> nodes_t;
+    static std::mutex mutex;
+    static std::map<std::pair<int,long>, std::shared_ptr<const nodes_t>> cache;
+
+    const auto key = std::make_pair(num_nodes, scalar_precision<T>::get());
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache.insert(std::make_pair(key, std::make_shared<const nodes_t>(
+                gauss_legendre_table_available<T>(num_nodes) ?
+                gauss_legendre_nodes_table<T>(num_nodes) : gauss_legendre_nodes_newton<T>(num_nodes)
+        ))).first;
+    }
+    return *(it->second);
+}
+
+}
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <mpreal.h>
+#include <Eigen/Core>
+
+namespace irlib {
+namespace detail {
+
+    typedef Eigen::Matrix<mpfr::mpreal, Eigen::Dynamic, Eigen::Dynamic> kernel_matrix_t;
+
+    /**
+     * Whether K provides batch evaluation on a grid:
+     *   void evaluate(const std::vector<mpreal> &x, const std::vector<mpreal> &y, kernel_matrix_t &values) const,
+     *   which sets values(i, j) = K(x[i], y[j]).
+     */
+    template<typename K>
+    class has_batch_evaluation {
+        template<typename U>
+        static auto test(int) -> decltype(
+                std::declval<const U &>().evaluate(
+                        std::declval<const std::vector<mpfr::mpreal> &>(),
+                        std::declval<const std::vector<mpfr::mpreal> &>(),
+                        std::declval<kernel_matrix_t &>()),
+                std::true_type());
+
+        template<typename>
+        static std::false_type test(...);
+
+    public:
+        static constexpr bool value = decltype(test<K>(0))::value;
+    };
+
+    /**
+     * Whether K satisfies the kernel concept used by compute_basis:
+     *   mpreal operator()(mpreal x, mpreal y) const,
+     *   statistics::statistics_type get_statistics() const,
+     *   double Lambda() const.
+     */
+    template<typename K>
+    class is_kernel {
+        template<typename U>
+        static auto test(int) -> decltype(
+                static_cast<mpfr::mpreal>(std::declval<const U &>()(std::declval<mpfr::mpreal>(), std::declval<mpfr::mpreal>())),
+                std::declval<const U &>().get_statistics(),
+                static_cast<double>(std::declval<const U &>().Lambda()),
+                std::true_type());
+
+        template<typename>
+        static std::false_type test(...);
+
+    public:
+        static constexpr bool value = decltype(test<K>(0))::value;
+    };
+
+    /// Evaluate a kernel on a grid using its batch evaluation
+    template<typename K>
+    typename std::enable_if<has_batch_evaluation<K>::value>::type
+    evaluate_kernel(const K &kernel, const std::vector<mpfr::mpreal> &x, const std::vector<mpfr::mpreal> &y,
+                    kernel_matrix_t &values) {
+        kernel.evaluate(x, y, values);
+    }
+
+    /// Evaluate a kernel on a grid point by point
+    template<typename K>
+    typename std::enable_if<!has_batch_evaluation<K>::value>::type
+    evaluate_kernel(const K &kernel, const std::vector<mpfr::mpreal> &x, const std::vector<mpfr::mpreal> &y,
+                    kernel_matrix_t &values) {
+        values.resize(x.size(), y.size());
+        for (int i = 0; i < x.size(); ++i) {
+            for (int j = 0; j < y.size(); ++j) {
+                values(i, j) = kernel(x[i], y[j]);
+            }
+        }
+    }
+
+    /**
+     * Kernel projected onto the even (sign = 1) or odd (sign = -1) sector: K(x, y) + sign * K(x, -y).
+     * The type of the original kernel is kept so that calls are resolved at compile time.
+     */
+    template<typename K>
+    class symmetrized_kernel {
+    public:
+        symmetrized_kernel(const K &kernel, int sign) : kernel_(kernel), sign_(sign) {}
+
+        mpfr::mpreal operator()(const mpfr::mpreal &x, const mpfr::mpreal &y) const {
+            return sign_ == 1 ? kernel_(x, y) + kernel_(x, -y) : kernel_(x, y) - kernel_(x, -y);
+        }
+
+        void evaluate(const std::vector<mpfr::mpreal> &x, const std::vector<mpfr::mpreal> &y, kernel_matrix_t &values) const {
+            std::vector<mpfr::mpreal> minus_y(y.size());
+            for (int j = 0; j < y.size(); ++j) {
+                minus_y[j] = -y[j];
+            }
+            kernel_matrix_t values_minus_y;
+            evaluate_kernel(kernel_, x, y, values);
+            evaluate_kernel(kernel_, x, minus_y, values_minus_y);
+            if (sign_ == 1) {
+                values += values_minus_y;
+            } else {
+                values -= values_minus_y;
+            }
+        }
+
+    private:
+        const K &kernel_;
+        int sign_;
+    };
+
+    /// Kernel with its arguments swapped: K(y, x)
+    template<typename K>
+    class transposed_kernel {
+    public:
+        explicit transposed_kernel(const K &kernel) : kernel_(kernel) {}
+
+        mpfr::mpreal operator()(const mpfr::mpreal &x, const mpfr::mpreal &y) const {
+            return kernel_(y, x);
+        }
+
+        void evaluate(const std::vector<mpfr::mpreal> &x, const std::vector<mpfr::mpreal> &y, kernel_matrix_t &values) const {
+            kernel_matrix_t values_yx;
+            evaluate_kernel(kernel_, y, x, values_yx);
+            values = values_yx.transpose();
+        }
+
+    private:
+        const K &kernel_;
+    };
+
+}
+}
@@ -1,6 +1,15 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 #include <mpreal.h>
+#include <Eigen/Core>
+
+#include "gauss_legendre_cache.hpp"
 
 namespace irlib {
 
@@ -51,8 +60,60 @@ namespace irlib {
         return sqrt(MPREAL(l) + MPREAL(0.5)) * legendre_p(l, x);
     }
 
+    /**
+     * Compute normalized Legendre polynomials for all l < Nl at given points in a single pass of the three-term recurrence
+     * @param Nl          The number of polynomials
+     * @param x           Points in [-1, 1]
+     * @param values      values(l, n) is the l-th normalized Legendre polynomial at x[n]
+     * @param derivatives If not null, derivatives(l, n) is the first derivative of the l-th normalized Legendre polynomial at x[n]
+     */
+    template<typename MPREAL>
+    void
+    normalized_legendre_p_all(unsigned int Nl, const std::vector<MPREAL> &x,
+                              Eigen::Matrix<MPREAL, Eigen::Dynamic, Eigen::Dynamic> &values,
+                              Eigen::Matrix<MPREAL, Eigen::Dynamic, Eigen::Dynamic> *derivatives = nullptr) {
+        const int num_x = x.size();
+        values.resize(Nl, num_x);
+        if (derivatives) {
+            derivatives->resize(Nl, num_x);
+        }
+        if (Nl == 0) {
+            return;
+        }
+
+        std::vector<MPREAL> norm(Nl);
+        for (int l = 0; l < Nl; ++l) {
+            norm[l] = sqrt(MPREAL(l) + MPREAL(0.5));
+        }
+
+        for (int n = 0; n < num_x; ++n) {
+            if (x[n] < MPREAL(-1) || x[n] > MPREAL(1)) {
+                throw std::runtime_error("Legendre polynomials are defined for -1<=x<=1");
+            }
+
+            // P_{l+1} = ((2l+1) x P_l - l P_{l-1})/(l+1),  P'_{l+1} = P'_{l-1} + (2l+1) P_l
+            MPREAL p0(1), p1(x[n]), dp0(0), dp1(1);
+            for (int l = 0; l < Nl; ++l) {
+                values(l, n) = norm[l] * p0;
+                if (derivatives) {
+                    (*derivatives)(l, n) = norm[l] * dp0;
+                }
+                if (l + 1 < Nl) {
+                    MPREAL p2 = detail::legendre_next(l + 1, x[n], p1, p0);
+                    MPREAL dp2 = dp0 + (2 * l + 3) * p1;
+                    p0 = p1;
+                    p1 = p2;
+                    dp0 = dp1;
+                    dp1 = dp2;
+                }
+            }
+        }
+    }
+
     /**
      * Compute derivatives of normalized Legendre polynomials at a given x
+     * The derivatives are computed by differentiating the three-term recurrence:
+     *   (l+1) P^{(d)}_{l+1}(x) = (2l+1) (x P^{(d)}_l(x) + d P^{(d-1)}_l(x)) - l P^{(d)}_{l-1}(x).
      * @param Nl The number of polynomials
      * @param x  -1 <= x <= 1
      * @return   Two dimension arrays (l, d). l is the index of polynoamials. d is the order of the derivatives.
@@ -60,75 +121,70 @@ namespace irlib {
     template<typename MPREAL>
     std::vector<std::vector<MPREAL>>
     normalized_legendre_p_derivatives(unsigned int Nl, const MPREAL &x) {
-        using matrix_t = Eigen::Matrix<MPREAL, Eigen::Dynamic, Eigen::Dynamic>;
-        using vector_t = Eigen::Matrix<MPREAL, Eigen::Dynamic, 1>;
-
-        matrix_t S(Nl, Nl);
-
-        // Overlap matrix for {x^l} in the interval of [-1,1].
-        for (int l1=0; l1<Nl; ++l1) {
-            for (int l2=0; l2<Nl; ++l2) {
-                if ((l1+l2)%2 == 0) {
-                    S(l1, l2) = MPREAL(2)/(MPREAL(l1+l2+1));
-                } else {
-                    S(l1, l2) = 0.0;
+        // Derivatives of (unnormalized) Legendre polynomials
+        std::vector<std::vector<MPREAL>> derivatives(Nl, std::vector<MPREAL>(Nl, MPREAL(0)));
+        if (Nl == 0) {
+            return derivatives;
+        }
+        derivatives[0][0] = MPREAL(1);
+        if (Nl > 1) {
+            derivatives[1][0] = x;
+            derivatives[1][1] = MPREAL(1);
+        }
+        for (int l = 1; l < static_cast<int>(Nl) - 1; ++l) {
+            for (int d = 0; d <= l + 1; ++d) {
+                MPREAL tmp = x * derivatives[l][d];
+                if (d > 0) {
+                    tmp += d * derivatives[l][d - 1];
                 }
+                derivatives[l + 1][d] = ((2 * l + 1) * tmp - l * derivatives[l - 1][d]) / (l + 1);
             }
         }
 
-        // {x^0, x^1, ..., x^{Nl-1}}
-        std::vector<vector_t> basis;
-        for (int l=0; l<Nl; ++l) {
-            vector_t  b(Nl);
-            b.setZero();
-            b(l) = MPREAL(1);
-            basis.push_back(b);
+        for (int l = 0; l < Nl; ++l) {
+            auto norm = sqrt(MPREAL(l) + MPREAL(0.5));
+            for (int d = 0; d < Nl; ++d) {
+                derivatives[l][d] *= norm;
+            }
         }
+        return derivatives;
+    }
 
-        // Gram–Schmidt orthonormalization
-        auto dot_product = [&](const vector_t & b1, const vector_t & b2) {
-            return (b1.transpose() * S * b2)(0,0);
-        };
-        for (int l1=0; l1<Nl; ++l1) {
-            for (int l2 = 0; l2 < l1; ++l2) {
-                basis[l1] -= (dot_product(basis[l1], basis[l2])/dot_product(basis[l2], basis[l2])) * basis[l2];
-            }
-            basis[l1] /= sqrt(dot_product(basis[l1], basis[l1]));
+    /**
+     * Compute derivatives of normalized Legendre polynomials at x = 1 or x = -1 in closed form:
+     *   P^{(d)}_l(1) = (l+d)!/(2^d d! (l-d)!) for d <= l,   P^{(d)}_l(-1) = (-1)^{l+d} P^{(d)}_l(1).
+     * The results are cached for each (Nl, x, default precision).
+     * @param Nl The number of polynomials
+     * @param x  1 or -1
+     * @return   Two dimension arrays (l, d). l is the index of polynoamials. d is the order of the derivatives.
+     */
+    template<typename MPREAL>
+    const std::vector<std::vector<MPREAL>> &
+    normalized_legendre_p_derivatives_endpoint(unsigned int Nl, int x) {
+        typedef std::vector<std::vector<MPREAL>> derivatives_t;
+        static std::mutex mutex;
+        static std::map<std::tuple<unsigned int, int, long>, std::shared_ptr<const derivatives_t>> cache;
+
+        if (x != 1 && x != -1) {
+            throw std::runtime_error("normalized_legendre_p_derivatives_endpoint: x must be 1 or -1");
         }
 
-        // compute the derived function of a given function
-        auto deriv = [](const vector_t& b) {
-            vector_t db(b);
-            db.setZero();
-            for (int i=0; i<b.rows()-1; ++i) {
-                db[i] = (i+1) * b[i+1];
-            }
-            return db;
-        };
-
-        // evaluate the value of a given function at a given x
-        auto eval = [](const vector_t& b, const MPREAL& x) {
-            MPREAL xn(1);
-            MPREAL val(0);
-            for (int n=0; n<b.rows(); ++n) {
-                val += b[n] * xn;
-                xn *= x;
-            }
-            return val;
-        };
-
-        std::vector<std::vector<MPREAL> > derivatives;
-        for (int l1=0; l1<Nl; ++l1) {
-            std::vector<MPREAL> db(Nl, MPREAL(0));
-            auto b = basis[l1];
-            for (int d=0; d<Nl; ++d) {
-                db[d] = eval(b, x);
-                b = deriv(b);
+        const auto key = std::make_tuple(Nl, x, detail::scalar_precision<MPREAL>::get());
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            std::shared_ptr<derivatives_t> derivatives(new derivatives_t(Nl, std::vector<MPREAL>(Nl, MPREAL(0))));
+            for (int l = 0; l < Nl; ++l) {
+                auto norm = sqrt(MPREAL(l) + MPREAL(0.5));
+                // P^{(d+1)}_l(1) = P^{(d)}_l(1) (l+d+1)(l-d) / (2(d+1))
+                MPREAL val(1);
+                for (int d = 0; d <= l; ++d) {
+                    (*derivatives)[l][d] = ((x == -1 && (l + d) % 2 == 1) ? -norm : norm) * val;
+                    val *= MPREAL((l + d + 1) * (l - d)) / MPREAL(2 * (d + 1));
+                }
             }
-            derivatives.push_back(db);
+            it = cache.insert(std::make_pair(key, std::shared_ptr<const derivatives_t>(derivatives))).first;
         }
-
-        return derivatives;
-
+        return *(it->second);
     }
 }
@@ -0,0 +1,29 @@
+#pragma once
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace irlib {
+    namespace detail {
+        /**
+         * Peak resident memory of the process in bytes (0 if it is not available on the platform).
+         * The value never decreases, so it includes the peak of previous phases.
+         */
+        inline long peak_memory_usage() {
+#if defined(__unix__) || defined(__APPLE__)
+            struct rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) != 0) {
+                return 0;
+            }
+#ifdef __APPLE__
+            return static_cast<long>(usage.ru_maxrss);
+#else
+            return static_cast<long>(usage.ru_maxrss) * 1024;
+#endif
+#else
+            return 0;
+#endif
+        }
+    }
+}
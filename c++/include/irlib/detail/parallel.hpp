@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include <mpreal.h>
+
+namespace irlib {
+    namespace detail {
+        /// Default number of threads (number of hardware threads)
+        inline int default_num_threads() {
+            return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+
+        /**
+         * Call f(i) for i = 0, ..., n-1 on a pool of threads.
+         * Work items are handed out one by one, so the load is balanced even if the costs of items differ.
+         * The default precision of mpreal is thread local in MPFR. Worker threads inherit that of the caller.
+         * An exception thrown in a worker thread is rethrown in the calling thread.
+         * @param n number of work items
+         * @param f function to be called
+         * @param num_threads number of threads (a value <= 0 means default_num_threads())
+         */
+        template<typename F>
+        void parallel_for(int n, const F &f, int num_threads = 0) {
+            if (num_threads <= 0) {
+                num_threads = default_num_threads();
+            }
+            num_threads = std::min(num_threads, n);
+
+            if (num_threads <= 1) {
+                for (int i = 0; i < n; ++i) {
+                    f(i);
+                }
+                return;
+            }
+
+            const mp_prec_t prec = mpfr::mpreal::get_default_prec();
+            std::atomic<int> next(0);
+            std::vector<std::exception_ptr> errors(num_threads);
+
+            auto worker = [&](int thread_id) {
+                try {
+                    for (int i = next++; i < n; i = next++) {
+                        f(i);
+                    }
+                } catch (...) {
+                    errors[thread_id] = std::current_exception();
+                    next = n;
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (int t = 1; t < num_threads; ++t) {
+                threads.push_back(std::thread([&worker, prec, t]() {
+                    mpfr::mpreal::set_default_prec(prec);
+                    worker(t);
+                    mpfr_free_cache();
+                }));
+            }
+            worker(0);
+            for (auto &th : threads) {
+                th.join();
+            }
+
+            for (const auto &e : errors) {
+                if (e) {
+                    std::rethrow_exception(e);
+                }
+            }
+        }
+    }
+}
@@ -29,6 +29,7 @@
 
 #include <cstdio>
 #include <cassert>
+#include <cstdlib>
 #include <vector>
 #include <algorithm>
 
@@ -77,6 +78,35 @@ public:
 };
 
 
+// tridiagonal matrix solver (Thomas algorithm)
+// the matrix is factorized once and can then be applied to many right hand sides
+template<typename T>
+class tridiagonal_matrix
+{
+private:
+    std::vector<T> m_lower;     // sub-diagonal, m_lower[0] is unused
+    std::vector<T> m_diag;      // diagonal
+    std::vector<T> m_upper;     // super-diagonal, m_upper[dim-1] is unused
+    bool m_factorized;
+public:
+    tridiagonal_matrix(): m_factorized(false) {};
+    tridiagonal_matrix(int dim);
+    void resize(int dim);
+    int dim() const
+    {
+        return m_diag.size();
+    }
+    // access operator, only |i-j|<=1 is allowed
+    T & operator () (int i, int j);
+    T   operator () (int i, int j) const;
+    void factorize();
+    // solves Ax=b in place
+    void solve(std::vector<T>& b) const;
+    // solves Ax=b in place for many right hand sides at once
+    void solve(std::vector< std::vector<T> >& b) const;
+};
+
+
 // spline interpolation
 template<typename T>
 class spline
@@ -119,6 +149,26 @@ public:
 };
 
 
+// cubic spline interpolation of many functions sampled on the same grid
+// the tridiagonal system depends only on the grid and is factorized once
+template<typename T>
+class spline_set
+{
+private:
+    std::vector<T> m_x;
+    std::vector< std::vector<T> > m_y, m_a, m_b, m_c;   // [function][point]
+public:
+    // zero curvature at both ends
+    void set_points(const std::vector<T>& x,
+                    const std::vector< std::vector<T> >& y);
+    int num_functions() const
+    {
+        return m_y.size();
+    }
+    T get_coeff(int function, int point, int power) const;
+};
+
+
 
 // ---------------------------------------------------------------------
 // implementation part, which could be separated into a cpp file
@@ -281,6 +331,80 @@ std::vector<T> band_matrix<T>::lu_solve(const std::vector<T>& b,
 
 
 
+// tridiagonal_matrix implementation
+// -------------------------
+
+template<typename T>
+tridiagonal_matrix<T>::tridiagonal_matrix(int dim)
+{
+    resize(dim);
+}
+template<typename T>
+void tridiagonal_matrix<T>::resize(int dim)
+{
+    assert(dim>0);
+    m_lower.assign(dim, T(0.0));
+    m_diag.assign(dim, T(0.0));
+    m_upper.assign(dim, T(0.0));
+    m_factorized=false;
+}
+template<typename T>
+T & tridiagonal_matrix<T>::operator () (int i, int j)
+{
+    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
+    assert( std::abs(i-j)<=1 );
+    m_factorized=false;
+    if(j==i)        return m_diag[i];
+    else if(j==i+1) return m_upper[i];
+    else            return m_lower[i];
+}
+template<typename T>
+T tridiagonal_matrix<T>::operator () (int i, int j) const
+{
+    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
+    assert( std::abs(i-j)<=1 );
+    if(j==i)        return m_diag[i];
+    else if(j==i+1) return m_upper[i];
+    else            return m_lower[i];
+}
+// LU factorization without pivoting (the spline matrix is diagonally dominant)
+// afterwards m_diag holds the inverse pivots and m_lower the multipliers
+template<typename T>
+void tridiagonal_matrix<T>::factorize()
+{
+    assert(m_diag[0]!=0.0);
+    m_diag[0]=1.0/m_diag[0];
+    for(int i=1; i<dim(); i++) {
+        m_lower[i] *= m_diag[i-1];
+        T pivot=m_diag[i]-m_lower[i]*m_upper[i-1];
+        assert(pivot!=0.0);
+        m_diag[i]=1.0/pivot;
+    }
+    m_factorized=true;
+}
+template<typename T>
+void tridiagonal_matrix<T>::solve(std::vector<T>& b) const
+{
+    assert(m_factorized);
+    assert( this->dim()==(int)b.size() );
+    int n=dim();
+    for(int i=1; i<n; i++) {
+        b[i] -= m_lower[i]*b[i-1];
+    }
+    b[n-1] *= m_diag[n-1];
+    for(int i=n-2; i>=0; i--) {
+        b[i]=(b[i]-m_upper[i]*b[i+1])*m_diag[i];
+    }
+}
+template<typename T>
+void tridiagonal_matrix<T>::solve(std::vector< std::vector<T> >& b) const
+{
+    for(size_t j=0; j<b.size(); j++) {
+        solve(b[j]);
+    }
+}
+
+
 // spline implementation
 // -----------------------
 
@@ -315,7 +439,7 @@ void spline<T>::set_points(const std::vector<T>& x,
     if(cubic_spline==true) { // cubic spline interpolation
         // setting up the matrix and right hand side of the equation system
         // for the parameters b[]
-        band_matrix<T> A(n,1,1);
+        tridiagonal_matrix<T> A(n);
         std::vector<T>  rhs(n);
         for(int i=1; i<n-1; i++) {
             A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
@@ -355,7 +479,9 @@ void spline<T>::set_points(const std::vector<T>& x,
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        A.factorize();
+        A.solve(rhs);
+        m_b=rhs;
 
         // calculate parameters a[] and c[] based on b[]
         m_a.resize(n);
@@ -433,6 +559,79 @@ T spline<T>::get_coeff(int idx, int power) const {
 
 
 
+
+// spline_set implementation
+// -----------------------
+
+template<typename T>
+void spline_set<T>::set_points(const std::vector<T>& x,
+                               const std::vector< std::vector<T> >& y)
+{
+    assert(x.size()>2);
+    int n=x.size();
+    int nf=y.size();
+    for(int i=0; i<n-1; i++) {
+        assert(x[i]<x[i+1]);
+    }
+    m_x=x;
+    m_y=y;
+
+    // the matrix depends only on x, factorize it once
+    tridiagonal_matrix<T> A(n);
+    for(int i=1; i<n-1; i++) {
+        A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
+        A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
+        A(i,i+1)=1.0/3.0*(x[i+1]-x[i]);
+    }
+    // zero curvature: 2*b[0] = 0, 2*b[n-1] = 0
+    A(0,0)=2.0;
+    A(0,1)=0.0;
+    A(n-1,n-1)=2.0;
+    A(n-1,n-2)=0.0;
+    A.factorize();
+
+    m_b.resize(nf);
+    for(int f=0; f<nf; f++) {
+        assert((int)y[f].size()==n);
+        m_b[f].assign(n, T(0.0));
+        for(int i=1; i<n-1; i++) {
+            m_b[f][i]=(y[f][i+1]-y[f][i])/(x[i+1]-x[i]) - (y[f][i]-y[f][i-1])/(x[i]-x[i-1]);
+        }
+    }
+    A.solve(m_b);
+
+    m_a.resize(nf);
+    m_c.resize(nf);
+    for(int f=0; f<nf; f++) {
+        m_a[f].assign(n, T(0.0));
+        m_c[f].assign(n, T(0.0));
+        for(int i=0; i<n-1; i++) {
+            m_a[f][i]=1.0/3.0*(m_b[f][i+1]-m_b[f][i])/(x[i+1]-x[i]);
+            m_c[f][i]=(y[f][i+1]-y[f][i])/(x[i+1]-x[i])
+                      - 1.0/3.0*(2.0*m_b[f][i]+m_b[f][i+1])*(x[i+1]-x[i]);
+        }
+    }
+}
+
+template<typename T>
+T spline_set<T>::get_coeff(int f, int idx, int power) const {
+    assert(f >= 0 && f < num_functions());
+    assert(idx >= 0);
+    assert(idx < m_x.size());
+    if (power == 0) {
+        return m_y[f][idx];
+    } else if (power == 1) {
+        return m_c[f][idx];
+    } else if (power == 2) {
+        return m_b[f][idx];
+    } else if (power == 3) {
+        return m_a[f][idx];
+    } else {
+        throw std::invalid_argument("invalid value of power");
+    }
+}
+
+
 } // namespace tk
 
 
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/QR>
+#include <Eigen/SVD>
+
+namespace irlib {
+    namespace detail {
+        /// Orthonormal basis of the column space of A (A must have full column rank)
+        inline Eigen::MatrixXd orthonormalize(const Eigen::MatrixXd &A) {
+            Eigen::HouseholderQR<Eigen::MatrixXd> qr(A);
+            return qr.householderQ() * Eigen::MatrixXd::Identity(A.rows(), A.cols());
+        }
+
+        /**
+         * Compute the leading singular triplets of a matrix by randomized subspace iteration.
+         * The cost is O(rows * cols * rank) instead of O(rows * cols * min(rows, cols)) for a full SVD.
+         * The subspace is re-orthonormalized after every multiplication, so that directions belonging to singular values
+         * much smaller than the largest one are not lost by round-off errors.
+         * The random starting matrix is generated from a fixed seed, so the results are reproducible.
+         * @param A matrix
+         * @param rank number of singular triplets (rank <= min(rows, cols))
+         * @param num_power_iterations number of subspace iterations
+         * @param svalues singular values in decreasing order
+         * @param U left singular vectors (rows x rank)
+         * @param V right singular vectors (cols x rank)
+         */
+        inline void truncated_svd(const Eigen::MatrixXd &A, int rank, int num_power_iterations,
+                                  Eigen::VectorXd &svalues, Eigen::MatrixXd &U, Eigen::MatrixXd &V) {
+            assert(rank > 0 && rank <= std::min(A.rows(), A.cols()));
+
+            std::mt19937 gen(1);
+            std::normal_distribution<double> dist;
+            Eigen::MatrixXd Omega(A.cols(), rank);
+            for (int j = 0; j < rank; ++j) {
+                for (int i = 0; i < A.cols(); ++i) {
+                    Omega(i, j) = dist(gen);
+                }
+            }
+
+            Eigen::MatrixXd Q = orthonormalize(A * Omega);
+            for (int it = 0; it < num_power_iterations; ++it) {
+                Q = orthonormalize(A * orthonormalize(A.transpose() * Q));
+            }
+
+            // A ~ Q Q^T A = Q B
+            Eigen::MatrixXd B = Q.transpose() * A;
+            Eigen::BDCSVD<Eigen::MatrixXd> svd(B, Eigen::ComputeThinU | Eigen::ComputeThinV);
+            svalues = svd.singularValues();
+            U = Q * svd.matrixU();
+            V = svd.matrixV();
+        }
+
+        /**
+         * Compute the SVD of a numerically low-rank matrix from a compressed representation A ~ Q R.
+         * Q (rows x rank) has orthonormal columns and is built by Gram-Schmidt with column pivoting,
+         * which stops when the norms of all remaining columns fall below tol times the largest column norm of A.
+         * Only the small core R (rank x cols) is passed to a full SVD, R = U_R S V^T, and U = Q U_R.
+         * A is overwritten by the part of the matrix that is not captured by Q R, so no copy of A is made.
+         * @param A matrix (destroyed)
+         * @param tol relative tolerance for the compression
+         * @param svalues singular values in decreasing order
+         * @param U left singular vectors (rows x rank)
+         * @param V right singular vectors (cols x rank)
+         */
+        template<typename Scalar>
+        void compressed_svd(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &A, double tol,
+                            Eigen::Matrix<Scalar, Eigen::Dynamic, 1> &svalues,
+                            Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &U,
+                            Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &V) {
+            using matrix_t = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+            using vector_t = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+            const int max_rank = std::min(A.rows(), A.cols());
+            std::vector<vector_t> q_cols;
+            std::vector<Eigen::Matrix<Scalar, 1, Eigen::Dynamic>> r_rows;
+
+            vector_t norms(A.cols());
+            for (int j = 0; j < A.cols(); ++j) {
+                norms(j) = A.col(j).norm();
+            }
+            const Scalar threshold = Scalar(tol) * norms.maxCoeff();
+
+            while (q_cols.size() < max_rank) {
+                int pivot;
+                const Scalar max_norm = norms.maxCoeff(&pivot);
+                if (!(max_norm > threshold)) {
+                    break;
+                }
+
+                // Orthogonalize twice against the previous columns to keep Q orthonormal to working precision
+                vector_t q = A.col(pivot) / max_norm;
+                for (int it = 0; it < 2; ++it) {
+                    for (const auto &qk : q_cols) {
+                        q -= qk.dot(q) * qk;
+                    }
+                    q /= q.norm();
+                }
+
+                // Deflate: A <- (1 - q q^T) A
+                Eigen::Matrix<Scalar, 1, Eigen::Dynamic> r = q.transpose() * A;
+                A.noalias() -= q * r;
+                for (int j = 0; j < A.cols(); ++j) {
+                    norms(j) = A.col(j).norm();
+                }
+
+                q_cols.push_back(q);
+                r_rows.push_back(r);
+            }
+
+            const int rank = std::max(static_cast<int>(q_cols.size()), 1);
+            matrix_t Q(A.rows(), rank), R(rank, A.cols());
+            Q.setZero();
+            R.setZero();
+            for (int k = 0; k < q_cols.size(); ++k) {
+                Q.col(k) = q_cols[k];
+                R.row(k) = r_rows[k];
+            }
+            q_cols.clear();
+            r_rows.clear();
+
+            Eigen::BDCSVD<matrix_t> svd(R, Eigen::ComputeThinU | Eigen::ComputeThinV);
+            svalues = svd.singularValues();
+            U = Q * svd.matrixU();
+            V = svd.matrixV();
+        }
+    }
+}
@@ -13,6 +13,16 @@
 namespace irlib {
     /**
      * Abstract class representing an analytical continuation kernel
+     *
+     * Kernels passed to compute_basis and generate_ir_basis_functions are template parameters,
+     * so any type satisfying the following concept can be used without deriving from kernel<T>:
+     *   mpreal operator()(mpreal x, mpreal y) const    the value of the kernel for x, y in [-1, 1]
+     *   statistics::statistics_type get_statistics() const
+     *   double Lambda() const
+     * The kernel must be invariant under (x, y) -> (-x, -y), so that the basis functions have definite parity.
+     * Optionally, a kernel may provide batch evaluation on a grid, which is used for building the kernel matrix:
+     *   void evaluate(const std::vector<mpreal> &x, const std::vector<mpreal> &y, detail::kernel_matrix_t &values) const
+     * where values(i, j) is set to K(x[i], y[j]).
      */
     template<typename T>
     class kernel {
@@ -46,7 +56,7 @@ namespace irlib {
      * Fermionic kernel
      */
     template<typename S>
-    class fermionic_kernel : public kernel<S> {
+    class fermionic_kernel final : public kernel<S> {
     public:
         fermionic_kernel(S Lambda) : Lambda_(Lambda) {}
 
@@ -84,7 +94,7 @@ namespace irlib {
     };
 
     template<>
-    class fermionic_kernel<mpreal> : public kernel<mpreal> {
+    class fermionic_kernel<mpreal> final : public kernel<mpreal> {
     public:
         fermionic_kernel(double Lambda) : Lambda_(Lambda) {}
 
@@ -92,14 +102,21 @@ namespace irlib {
 
         mpreal operator()(mpreal x, mpreal y) const {
             mpreal half_Lambda = mpreal("0.5") * mpreal(Lambda_);
+            mpreal shift, denom;
+            y_factors(half_Lambda, y, shift, denom);
+            return mpfr::exp(-half_Lambda * x * y + shift) / denom;
+        }
 
-            const double limit = 200.0;
-            if (Lambda_ * y > limit) {
-                return mpfr::exp(-half_Lambda * x * y - half_Lambda * y);
-            } else if (Lambda_ * y < -limit) {
-                return mpfr::exp(-half_Lambda * x * y + half_Lambda * y);
-            } else {
-                return mpfr::exp(-half_Lambda * x * y) / (2 * mpfr::cosh(half_Lambda * y));
+        /// Evaluate the kernel on a grid. Factors depending only on y are computed once for each y.
+        void evaluate(const std::vector<mpreal> &x, const std::vector<mpreal> &y, detail::kernel_matrix_t &values) const {
+            mpreal half_Lambda = mpreal("0.5") * mpreal(Lambda_);
+            mpreal shift, denom;
+            values.resize(x.size(), y.size());
+            for (int j = 0; j < y.size(); ++j) {
+                y_factors(half_Lambda, y[j], shift, denom);
+                for (int i = 0; i < x.size(); ++i) {
+                    values(i, j) = mpfr::exp(-half_Lambda * x[i] * y[j] + shift) / denom;
+                }
             }
         }
 
@@ -121,6 +138,21 @@ namespace irlib {
 
     private:
         double Lambda_;
+
+        /// K(x, y) = exp(-Lambda x y / 2 + shift) / denom. The branches avoid overflow of cosh for large |Lambda y|.
+        void y_factors(const mpreal &half_Lambda, const mpreal &y, mpreal &shift, mpreal &denom) const {
+            const double limit = 200.0;
+            if (Lambda_ * y > limit) {
+                shift = -half_Lambda * y;
+                denom = 1;
+            } else if (Lambda_ * y < -limit) {
+                shift = half_Lambda * y;
+                denom = 1;
+            } else {
+                shift = 0;
+                denom = 2 * mpfr::cosh(half_Lambda * y);
+            }
+        }
     };
 
 
@@ -128,7 +160,7 @@ namespace irlib {
      * Bosonic kernel
      */
     template<typename S>
-    class bosonic_kernel : public kernel<S> {
+    class bosonic_kernel final : public kernel<S> {
     public:
         bosonic_kernel(double Lambda) : Lambda_(Lambda) {}
 
@@ -168,24 +200,29 @@ namespace irlib {
     };
 
     template<>
-    class bosonic_kernel<mpreal> : public kernel<mpreal> {
+    class bosonic_kernel<mpreal> final : public kernel<mpreal> {
     public:
         bosonic_kernel(double Lambda) : Lambda_(Lambda) {}
 
         virtual ~bosonic_kernel() {};
 
         mpreal operator()(mpreal x, mpreal y) const {
-            const double limit = 200.0;
             mpreal half_Lambda = mpreal("0.5") * mpreal(Lambda_);
+            mpreal numer, shift, denom;
+            y_factors(half_Lambda, y, numer, shift, denom);
+            return numer * mpfr::exp(-half_Lambda * x * y + shift) / denom;
+        }
 
-            if (mpfr::abs(Lambda_ * y) < 1e-30) {
-                return mpfr::exp(-half_Lambda * x * y) / Lambda_;
-            } else if (Lambda_ * y > limit) {
-                return y * mpfr::exp(-half_Lambda * x * y - half_Lambda * y);
-            } else if (Lambda_ * y < -limit) {
-                return -y * mpfr::exp(-half_Lambda * x * y + half_Lambda * y);
-            } else {
-                return y * mpfr::exp(-half_Lambda * x * y) / (2 * mpfr::sinh(half_Lambda * y));
+        /// Evaluate the kernel on a grid. Factors depending only on y are computed once for each y.
+        void evaluate(const std::vector<mpreal> &x, const std::vector<mpreal> &y, detail::kernel_matrix_t &values) const {
+            mpreal half_Lambda = mpreal("0.5") * mpreal(Lambda_);
+            mpreal numer, shift, denom;
+            values.resize(x.size(), y.size());
+            for (int j = 0; j < y.size(); ++j) {
+                y_factors(half_Lambda, y[j], numer, shift, denom);
+                for (int i = 0; i < x.size(); ++i) {
+                    values(i, j) = numer * mpfr::exp(-half_Lambda * x[i] * y[j] + shift) / denom;
+                }
             }
         }
 
@@ -207,6 +244,28 @@ namespace irlib {
 
     private:
         double Lambda_;
+
+        /// K(x, y) = numer * exp(-Lambda x y / 2 + shift) / denom. The branches avoid overflow of sinh for large |Lambda y|.
+        void y_factors(const mpreal &half_Lambda, const mpreal &y, mpreal &numer, mpreal &shift, mpreal &denom) const {
+            const double limit = 200.0;
+            if (mpfr::abs(Lambda_ * y) < 1e-30) {
+                numer = 1;
+                shift = 0;
+                denom = Lambda_;
+            } else if (Lambda_ * y > limit) {
+                numer = y;
+                shift = -half_Lambda * y;
+                denom = 1;
+            } else if (Lambda_ * y < -limit) {
+                numer = -y;
+                shift = half_Lambda * y;
+                denom = 1;
+            } else {
+                numer = y;
+                shift = 0;
+                denom = 2 * mpfr::sinh(half_Lambda * y);
+            }
+        }
     };
 
 
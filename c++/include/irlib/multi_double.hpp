@@ -0,0 +1,530 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+#include <mpreal.h>
+#include <Eigen/Core>
+
+namespace irlib {
+
+    namespace detail {
+        /// s + err = a + b exactly
+        inline double two_sum(double a, double b, double &err) {
+            double s = a + b;
+            double bb = s - a;
+            err = (a - (s - bb)) + (b - bb);
+            return s;
+        }
+
+        /// s + err = a + b exactly, assuming |a| >= |b|
+        inline double quick_two_sum(double a, double b, double &err) {
+            double s = a + b;
+            err = b - (s - a);
+            return s;
+        }
+
+        /// hi + lo = a, where hi and lo have at most 26 significant bits
+        inline void split(double a, double &hi, double &lo) {
+            const double splitter = 134217729.0; // 2^27 + 1
+            double temp = splitter * a;
+            hi = temp - (temp - a);
+            lo = a - hi;
+        }
+
+        /// p + err = a * b exactly
+        inline double two_prod(double a, double b, double &err) {
+            double p = a * b;
+#ifdef FP_FAST_FMA
+            err = std::fma(a, b, -p);
+#else
+            // Dekker's algorithm (std::fma is emulated in software without hardware support)
+            double a_hi, a_lo, b_hi, b_lo;
+            split(a, a_hi, a_lo);
+            split(b, b_hi, b_lo);
+            err = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+#endif
+            return p;
+        }
+
+        inline void three_sum(double &a, double &b, double &c) {
+            double t1, t2, t3;
+            t1 = two_sum(a, b, t2);
+            a = two_sum(c, t1, t3);
+            b = two_sum(t2, t3, c);
+        }
+
+        inline void three_sum2(double &a, double &b, double &c) {
+            double t1, t2, t3;
+            t1 = two_sum(a, b, t2);
+            a = two_sum(c, t1, t3);
+            b = t2 + t3;
+        }
+
+        inline void renorm(double &c0, double &c1, double &c2, double &c3) {
+            double s0, s1, s2 = 0.0, s3 = 0.0;
+            if (std::isinf(c0)) {
+                return;
+            }
+            s0 = quick_two_sum(c2, c3, c3);
+            s0 = quick_two_sum(c1, s0, c2);
+            c0 = quick_two_sum(c0, s0, c1);
+            s0 = c0;
+            s1 = c1;
+            if (s1 != 0.0) {
+                s1 = quick_two_sum(s1, c2, s2);
+                if (s2 != 0.0) {
+                    s2 = quick_two_sum(s2, c3, s3);
+                } else {
+                    s1 = quick_two_sum(s1, c3, s2);
+                }
+            } else {
+                s0 = quick_two_sum(s0, c2, s1);
+                if (s1 != 0.0) {
+                    s1 = quick_two_sum(s1, c3, s2);
+                } else {
+                    s0 = quick_two_sum(s0, c3, s1);
+                }
+            }
+            c0 = s0;
+            c1 = s1;
+            c2 = s2;
+            c3 = s3;
+        }
+
+        inline void renorm(double &c0, double &c1, double &c2, double &c3, double &c4) {
+            double s0, s1, s2 = 0.0, s3 = 0.0;
+            if (std::isinf(c0)) {
+                return;
+            }
+            s0 = quick_two_sum(c3, c4, c4);
+            s0 = quick_two_sum(c2, s0, c3);
+            s0 = quick_two_sum(c1, s0, c2);
+            c0 = quick_two_sum(c0, s0, c1);
+            s0 = c0;
+            s1 = c1;
+            if (s1 != 0.0) {
+                s1 = quick_two_sum(s1, c2, s2);
+                if (s2 != 0.0) {
+                    s2 = quick_two_sum(s2, c3, s3);
+                    if (s3 != 0.0) {
+                        s3 += c4;
+                    } else {
+                        s2 = quick_two_sum(s2, c4, s3);
+                    }
+                } else {
+                    s1 = quick_two_sum(s1, c3, s2);
+                    if (s2 != 0.0) {
+                        s2 = quick_two_sum(s2, c4, s3);
+                    } else {
+                        s1 = quick_two_sum(s1, c4, s2);
+                    }
+                }
+            } else {
+                s0 = quick_two_sum(s0, c2, s1);
+                if (s1 != 0.0) {
+                    s1 = quick_two_sum(s1, c3, s2);
+                    if (s2 != 0.0) {
+                        s2 = quick_two_sum(s2, c4, s3);
+                    } else {
+                        s1 = quick_two_sum(s1, c4, s2);
+                    }
+                } else {
+                    s0 = quick_two_sum(s0, c3, s1);
+                    if (s1 != 0.0) {
+                        s1 = quick_two_sum(s1, c4, s2);
+                    } else {
+                        s0 = quick_two_sum(s0, c4, s1);
+                    }
+                }
+            }
+            c0 = s0;
+            c1 = s1;
+            c2 = s2;
+            c3 = s3;
+        }
+    }
+
+    /**
+     * Floating-point number represented by an unevaluated sum of N doubles (x_0 + x_1 + ... + x_{N-1}, |x_{i+1}| <= ulp(x_i)/2).
+     * N = 2 (double-double, about 32 digits) and N = 4 (quad-double, about 64 digits) are supported.
+     * The arithmetic follows the algorithms of the QD library by Hida, Li and Bailey and runs on hardware doubles.
+     */
+    template<int N>
+    class multi_double {
+        static_assert(N == 2 || N == 4, "multi_double supports N = 2 and N = 4.");
+
+    public:
+        multi_double() {
+            for (int i = 0; i < N; ++i) {
+                x_[i] = 0.0;
+            }
+        }
+
+        multi_double(double x) {
+            x_[0] = x;
+            for (int i = 1; i < N; ++i) {
+                x_[i] = 0.0;
+            }
+        }
+
+        multi_double(int x) : multi_double(static_cast<double>(x)) {}
+
+        multi_double(long x) : multi_double(static_cast<double>(x)) {}
+
+        multi_double(long double x) {
+            for (int i = 0; i < N; ++i) {
+                x_[i] = static_cast<double>(x);
+                x -= x_[i];
+            }
+        }
+
+        explicit multi_double(const mpfr::mpreal &x) {
+            mpfr::mpreal r(x);
+            for (int i = 0; i < N; ++i) {
+                x_[i] = r.toDouble();
+                r -= x_[i];
+            }
+        }
+
+        /// Construct from components, which must be normalized
+        static multi_double from_components(const double *x) {
+            multi_double r;
+            for (int i = 0; i < N; ++i) {
+                r.x_[i] = x[i];
+            }
+            return r;
+        }
+
+        /// i-th component
+        double operator[](int i) const {
+            return x_[i];
+        }
+
+        explicit operator double() const {
+            return x_[0];
+        }
+
+        explicit operator long double() const {
+            long double r = 0.0;
+            for (int i = N - 1; i >= 0; --i) {
+                r += x_[i];
+            }
+            return r;
+        }
+
+        /// Convert to mpreal at the current default precision
+        explicit operator mpfr::mpreal() const {
+            mpfr::mpreal r(x_[N - 1]);
+            for (int i = N - 2; i >= 0; --i) {
+                r += x_[i];
+            }
+            return r;
+        }
+
+        multi_double operator-() const {
+            multi_double r;
+            for (int i = 0; i < N; ++i) {
+                r.x_[i] = -x_[i];
+            }
+            return r;
+        }
+
+        multi_double &operator+=(const multi_double &b) {
+            return *this = *this + b;
+        }
+
+        multi_double &operator-=(const multi_double &b) {
+            return *this = *this - b;
+        }
+
+        multi_double &operator*=(const multi_double &b) {
+            return *this = *this * b;
+        }
+
+        multi_double &operator/=(const multi_double &b) {
+            return *this = *this / b;
+        }
+
+        // Infinities and NaNs are handled like double by looking only at the leading components.
+        // Otherwise, the error-free transforms would turn an infinity into a NaN.
+
+        friend multi_double operator+(const multi_double &a, const multi_double &b) {
+            const double s = a.x_[0] + b.x_[0];
+            return std::isfinite(s) ? add(a, b) : multi_double(s);
+        }
+
+        friend multi_double operator-(const multi_double &a, const multi_double &b) {
+            return a + (-b);
+        }
+
+        friend multi_double operator*(const multi_double &a, const multi_double &b) {
+            const double p = a.x_[0] * b.x_[0];
+            return std::isfinite(p) ? mul(a, b) : multi_double(p);
+        }
+
+        friend multi_double operator/(const multi_double &a, const multi_double &b) {
+            const double q = a.x_[0] / b.x_[0];
+            return std::isfinite(q) && std::isfinite(b.x_[0]) && b.x_[0] != 0.0 ? div(a, b) : multi_double(q);
+        }
+
+        friend bool operator==(const multi_double &a, const multi_double &b) {
+            for (int i = 0; i < N; ++i) {
+                if (a.x_[i] != b.x_[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        friend bool operator!=(const multi_double &a, const multi_double &b) {
+            return !(a == b);
+        }
+
+        friend bool operator<(const multi_double &a, const multi_double &b) {
+            for (int i = 0; i < N; ++i) {
+                if (a.x_[i] != b.x_[i]) {
+                    return a.x_[i] < b.x_[i];
+                }
+            }
+            return false;
+        }
+
+        friend bool operator>(const multi_double &a, const multi_double &b) {
+            return b < a;
+        }
+
+        friend bool operator<=(const multi_double &a, const multi_double &b) {
+            return !(b < a);
+        }
+
+        friend bool operator>=(const multi_double &a, const multi_double &b) {
+            return !(a < b);
+        }
+
+        friend multi_double abs(const multi_double &a) {
+            return a.x_[0] < 0.0 ? -a : a;
+        }
+
+        friend multi_double fabs(const multi_double &a) {
+            return abs(a);
+        }
+
+        /// Square root by Newton's iteration for 1/sqrt(a)
+        friend multi_double sqrt(const multi_double &a) {
+            if (a.x_[0] == 0.0) {
+                return multi_double();
+            }
+            if (a.x_[0] < 0.0) {
+                return multi_double(std::numeric_limits<double>::quiet_NaN());
+            }
+            multi_double r(1.0 / std::sqrt(a.x_[0]));
+            const multi_double h = a * multi_double(0.5);
+            for (int i = 0; i < (N == 2 ? 2 : 3); ++i) {
+                r += (multi_double(0.5) - h * (r * r)) * r;
+            }
+            return a * r;
+        }
+
+        friend bool isfinite(const multi_double &a) {
+            return std::isfinite(a.x_[0]);
+        }
+
+        friend bool isnan(const multi_double &a) {
+            return std::isnan(a.x_[0]);
+        }
+
+        friend bool isinf(const multi_double &a) {
+            return std::isinf(a.x_[0]);
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, const multi_double &a) {
+            auto prec_bak = mpfr::mpreal::get_default_prec();
+            mpfr::mpreal::set_default_prec(53 * N);
+            os << static_cast<mpfr::mpreal>(a);
+            mpfr::mpreal::set_default_prec(prec_bak);
+            return os;
+        }
+
+    private:
+        double x_[N];
+
+        static multi_double add(const multi_double<2> &a, const multi_double<2> &b) {
+            double s1, s2, t1, t2;
+            s1 = detail::two_sum(a.x_[0], b.x_[0], s2);
+            t1 = detail::two_sum(a.x_[1], b.x_[1], t2);
+            s2 += t1;
+            s1 = detail::quick_two_sum(s1, s2, s2);
+            s2 += t2;
+            s1 = detail::quick_two_sum(s1, s2, s2);
+            const double r[2] = {s1, s2};
+            return from_components(r);
+        }
+
+        static multi_double mul(const multi_double<2> &a, const multi_double<2> &b) {
+            double p1, p2;
+            p1 = detail::two_prod(a.x_[0], b.x_[0], p2);
+            p2 += (a.x_[0] * b.x_[1] + a.x_[1] * b.x_[0]);
+            p1 = detail::quick_two_sum(p1, p2, p2);
+            const double r[2] = {p1, p2};
+            return from_components(r);
+        }
+
+        static multi_double div(const multi_double<2> &a, const multi_double<2> &b) {
+            double q1, q2, q3;
+            q1 = a.x_[0] / b.x_[0];
+            multi_double r = a - b * multi_double(q1);
+            q2 = r.x_[0] / b.x_[0];
+            r -= b * multi_double(q2);
+            q3 = r.x_[0] / b.x_[0];
+            q1 = detail::quick_two_sum(q1, q2, q2);
+            const double q[2] = {q1, q2};
+            return from_components(q) + multi_double(q3);
+        }
+
+        static multi_double add(const multi_double<4> &a, const multi_double<4> &b) {
+            double s0, s1, s2, s3;
+            double t0, t1, t2, t3;
+            s0 = detail::two_sum(a.x_[0], b.x_[0], t0);
+            s1 = detail::two_sum(a.x_[1], b.x_[1], t1);
+            s2 = detail::two_sum(a.x_[2], b.x_[2], t2);
+            s3 = detail::two_sum(a.x_[3], b.x_[3], t3);
+
+            s1 = detail::two_sum(s1, t0, t0);
+            detail::three_sum(s2, t0, t1);
+            detail::three_sum2(s3, t0, t2);
+            t0 = t0 + t1 + t3;
+
+            detail::renorm(s0, s1, s2, s3, t0);
+            const double r[4] = {s0, s1, s2, s3};
+            return from_components(r);
+        }
+
+        static multi_double mul(const multi_double<4> &a, const multi_double<4> &b) {
+            double p0, p1, p2, p3, p4, p5;
+            double q0, q1, q2, q3, q4, q5;
+            double t0, t1;
+            double s0, s1, s2;
+
+            p0 = detail::two_prod(a.x_[0], b.x_[0], q0);
+
+            p1 = detail::two_prod(a.x_[0], b.x_[1], q1);
+            p2 = detail::two_prod(a.x_[1], b.x_[0], q2);
+
+            p3 = detail::two_prod(a.x_[0], b.x_[2], q3);
+            p4 = detail::two_prod(a.x_[1], b.x_[1], q4);
+            p5 = detail::two_prod(a.x_[2], b.x_[0], q5);
+
+            detail::three_sum(p1, p2, q0);
+
+            // Six-three sum of p2, q1, q2, p3, p4, p5
+            detail::three_sum(p2, q1, q2);
+            detail::three_sum(p3, p4, p5);
+            s0 = detail::two_sum(p2, p3, t0);
+            s1 = detail::two_sum(q1, p4, t1);
+            s2 = q2 + p5;
+            s1 = detail::two_sum(s1, t0, t0);
+            s2 += (t0 + t1);
+
+            // O(eps^3) terms
+            s1 += a.x_[0] * b.x_[3] + a.x_[1] * b.x_[2] + a.x_[2] * b.x_[1] + a.x_[3] * b.x_[0] + q0 + q3 + q4 + q5;
+            detail::renorm(p0, p1, s0, s1, s2);
+            const double r[4] = {p0, p1, s0, s1};
+            return from_components(r);
+        }
+
+        static multi_double div(const multi_double<4> &a, const multi_double<4> &b) {
+            double q0, q1, q2, q3;
+            q0 = a.x_[0] / b.x_[0];
+            multi_double r = a - b * multi_double(q0);
+            q1 = r.x_[0] / b.x_[0];
+            r -= b * multi_double(q1);
+            q2 = r.x_[0] / b.x_[0];
+            r -= b * multi_double(q2);
+            q3 = r.x_[0] / b.x_[0];
+            detail::renorm(q0, q1, q2, q3);
+            const double q[4] = {q0, q1, q2, q3};
+            return from_components(q);
+        }
+    };
+
+    /// Double-double (about 32 significant digits)
+    typedef multi_double<2> dd_real;
+
+    /// Quad-double (about 64 significant digits)
+    typedef multi_double<4> qd_real;
+}
+
+namespace std {
+    template<int N>
+    class numeric_limits<irlib::multi_double<N>> : public numeric_limits<double> {
+    public:
+        static const int digits = 53 * N;
+        static const int digits10 = N == 2 ? 31 : 62;
+
+        static irlib::multi_double<N> epsilon() {
+            return irlib::multi_double<N>(std::ldexp(1.0, N == 2 ? -104 : -209));
+        }
+
+        static irlib::multi_double<N> min() {
+            return irlib::multi_double<N>(std::ldexp(1.0, -1022 + 53 * (N - 1)));
+        }
+
+        static irlib::multi_double<N> max() {
+            return irlib::multi_double<N>(numeric_limits<double>::max());
+        }
+
+        static irlib::multi_double<N> lowest() {
+            return -max();
+        }
+
+        static irlib::multi_double<N> infinity() {
+            return irlib::multi_double<N>(numeric_limits<double>::infinity());
+        }
+
+        static irlib::multi_double<N> quiet_NaN() {
+            return irlib::multi_double<N>(numeric_limits<double>::quiet_NaN());
+        }
+    };
+}
+
+namespace Eigen {
+    template<int N>
+    struct NumTraits<irlib::multi_double<N>> : GenericNumTraits<irlib::multi_double<N>> {
+        typedef irlib::multi_double<N> Real;
+        typedef irlib::multi_double<N> NonInteger;
+        typedef irlib::multi_double<N> Nested;
+        typedef irlib::multi_double<N> Literal;
+
+        enum {
+            IsInteger = 0,
+            IsSigned = 1,
+            IsComplex = 0,
+            RequireInitialization = 1,
+            ReadCost = N,
+            AddCost = 10 * N,
+            MulCost = 10 * N
+        };
+
+        static inline Real epsilon() {
+            return std::numeric_limits<Real>::epsilon();
+        }
+
+        static inline Real dummy_precision() {
+            return epsilon() * Real(1024.0);
+        }
+
+        static inline Real highest() {
+            return (std::numeric_limits<Real>::max)();
+        }
+
+        static inline Real lowest() {
+            return std::numeric_limits<Real>::lowest();
+        }
+
+        static inline int digits10() {
+            return std::numeric_limits<Real>::digits10;
+        }
+    };
+}
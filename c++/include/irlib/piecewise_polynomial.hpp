@@ -76,12 +76,62 @@ namespace irlib {
         struct pp_minus : public pp_element_wise_op<T, std::minus<T> > {
         };
 
+        /// real scalar type underlying T (T itself unless T is complex)
+        template<class T>
+        struct real_scalar {
+            typedef T type;
+        };
+
+        template<class T>
+        struct real_scalar<std::complex<T> > {
+            typedef T type;
+        };
+
+        /// Cast a value of x into the scalar type of coefficients
+        template<class T, class Tx>
+        T x_to_coeff(const Tx &x) {
+            return static_cast<T>(static_cast<typename real_scalar<T>::type>(x));
+        }
+
+        /**
+         * Build the union of two sets of section edges by a merge walk.
+         * Both meshes must cover the same interval.
+         * @param edges1 section edges in ascending order
+         * @param edges2 section edges in ascending order
+         * @return section edges of the common refinement
+         */
+        template<typename Tx>
+        std::vector<Tx>
+        merge_section_edges(const std::vector<Tx> &edges1, const std::vector<Tx> &edges2) {
+            if (edges1.front() != edges2.front() || edges1.back() != edges2.back()) {
+                throw std::runtime_error("Piecewise polynomials must be defined on the same interval!");
+            }
+
+            std::vector<Tx> edges;
+            edges.reserve(edges1.size() + edges2.size());
+            auto it1 = edges1.begin(), it2 = edges2.begin();
+            while (it1 != edges1.end() || it2 != edges2.end()) {
+                if (it2 == edges2.end() || (it1 != edges1.end() && *it1 < *it2)) {
+                    edges.push_back(*it1++);
+                } else if (it1 == edges1.end() || *it2 < *it1) {
+                    edges.push_back(*it2++);
+                } else {
+                    edges.push_back(*it1);
+                    ++it1;
+                    ++it2;
+                }
+            }
+            return edges;
+        }
+
 ///  element-Wise operations on piecewise_polynomial coefficients
         template<typename T, typename Tx, typename Op>
         piecewise_polynomial<T,Tx>
         do_op(const piecewise_polynomial<T,Tx> &f1, const piecewise_polynomial<T,Tx> &f2, const Op &op) {
             if (f1.section_edges_ != f2.section_edges_) {
-                throw std::runtime_error("Cannot add two numerical functions with different sections!");
+                // Re-expand both operands on the common refinement of the two meshes
+                auto section_edges = merge_section_edges(f1.section_edges_, f2.section_edges_);
+                return do_op(f1.refine(section_edges), f2.refine(section_edges), op);
             }
 
             const int k_new = std::max(f1.order(), f2.order());
@@ -113,6 +163,8 @@ namespace irlib {
 /**
  * Class for representing a piecewise polynomial
  *   A function is represented by a polynomial in each section [x_n, x_{n+1}).
+ *   Sections may have different orders: order() is the largest one, and the higher coefficients
+ *   of a section of lower order vanish (see section_order()).
  */
     template<typename T, typename Tx>
     class piecewise_polynomial {
@@ -223,6 +275,16 @@ namespace irlib {
             return k_;
         }
 
+        /// Order of the polynomial in the given section (the highest power with a non-zero coefficient, 0 for a vanishing section)
+        int section_order(int section) const {
+            assert(section >= 0 && section < n_sections_);
+            int k = k_;
+            while (k > 0 && coeff_(section, k) == T(0)) {
+                --k;
+            }
+            return k;
+        }
+
         /// Number of sections
         int num_sections() const {
 #ifndef NDEBUG
@@ -273,6 +335,47 @@ namespace irlib {
             coeff_.setZero();
         }
 
+        /// Replace the function by its derivative of the given order (in place).
+        void differentiate(int order = 1) {
+            check_validity();
+            assert(order >= 0);
+            const int k_new = std::max(k_ - order, 0);
+            coefficient_type coeff(n_sections_, k_new + 1);
+            coeff.setZero();
+            for (int p = 0; p + order <= k_; ++p) {
+                // (p+order)!/p!
+                T fact = 1.0;
+                for (int m = p + 1; m <= p + order; ++m) {
+                    fact *= m;
+                }
+                for (int s = 0; s < n_sections_; ++s) {
+                    coeff(s, p) = fact * coeff_(s, p + order);
+                }
+            }
+            coeff_.swap(coeff);
+            k_ = k_new;
+        }
+
+        /// Replace the function by its antiderivative vanishing at the left end of the domain (in place).
+        /// The result is continuous across sections.
+        void antidifferentiate() {
+            check_validity();
+            coefficient_type coeff(n_sections_, k_ + 2);
+            T integral = 0.0;
+            for (int s = 0; s < n_sections_; ++s) {
+                const T dx = detail::x_to_coeff<T>(section_edges_[s + 1] - section_edges_[s]);
+                coeff(s, 0) = integral;
+                T dx_power = dx;
+                for (int p = 0; p < k_ + 1; ++p) {
+                    coeff(s, p + 1) = coeff_(s, p) / T(p + 1);
+                    integral += coeff(s, p + 1) * dx_power;
+                    dx_power *= dx;
+                }
+            }
+            coeff_.swap(coeff);
+            k_ += 1;
+        }
+
         /// Compute the value at x.
         template<typename Tw = Tx>
         inline T compute_value(Tx x) const {
@@ -344,13 +447,56 @@ namespace irlib {
             return (&(*it) - &(section_edges_[0]));
         }
 
-        /// Compute overlap <this | other> with complex conjugate. The two objects must have the same sections.
+        /**
+         * Re-expand the polynomial on a finer mesh.
+         * @param section_edges new section edges, which must include all the current section edges
+         * @return the same function represented on the new mesh
+         */
+        piecewise_polynomial<T,Tx> refine(const std::vector<Tx> &section_edges) const {
+            check_validity();
+            if (section_edges.front() != section_edges_.front() || section_edges.back() != section_edges_.back()) {
+                throw std::runtime_error("The new mesh must cover the same interval!");
+            }
+
+            const int n_sections_new = section_edges.size() - 1;
+            coefficient_type coeff(n_sections_new, k_ + 1);
+            std::vector<T> c(k_ + 1);
+
+            int s = 0;
+            for (int s_new = 0; s_new < n_sections_new; ++s_new) {
+                while (section_edges_[s + 1] <= section_edges[s_new]) {
+                    ++s;
+                }
+                if (section_edges[s_new + 1] > section_edges_[s + 1]) {
+                    throw std::runtime_error("The new mesh is not a refinement of the current one!");
+                }
+
+                // Taylor shift from the left end of the old section to that of the new one
+                const T h = detail::x_to_coeff<T>(section_edges[s_new] - section_edges_[s]);
+                for (int p = 0; p < k_ + 1; ++p) {
+                    c[p] = coeff_(s, p);
+                }
+                for (int i = 0; i < k_; ++i) {
+                    for (int p = k_ - 1; p >= i; --p) {
+                        c[p] += h * c[p + 1];
+                    }
+                }
+                for (int p = 0; p < k_ + 1; ++p) {
+                    coeff(s_new, p) = c[p];
+                }
+            }
+
+            return piecewise_polynomial<T,Tx>(n_sections_new, section_edges, coeff);
+        }
+
+        /// Compute overlap <this | other> with complex conjugate.
+        /// If the two objects have different sections, both are re-expanded on the common refinement.
         template<class T2>
         T overlap(const piecewise_polynomial<T2,Tx> &other) const {
             check_validity();
             if (section_edges_ != other.section_edges_) {
-                throw std::runtime_error(
-                        "Computing overlap between piecewise polynomials with different section edges are not supported");
+                auto section_edges = detail::merge_section_edges(section_edges_, other.section_edges_);
+                return refine(section_edges).overlap(other.refine(section_edges));
             }
             using Tr = typename std::remove_const<decltype(static_cast<T>(1.0) * static_cast<T2>(1.0))>::type;
 
@@ -440,7 +586,9 @@ namespace irlib {
     piecewise_polynomial<T,Tx>
     multiply(const piecewise_polynomial<T,Tx> &f1, const piecewise_polynomial<T,Tx> &f2) {
         if (f1.section_edges() != f2.section_edges()) {
-            throw std::runtime_error("Two pieacewise_polynomial objects with different sections cannot be multiplied.");
+            // Re-expand both operands on the common refinement of the two meshes
+            auto section_edges = detail::merge_section_edges(f1.section_edges(), f2.section_edges());
+            return multiply(f1.refine(section_edges), f2.refine(section_edges));
         }
 
         const int k1 = f1.order();
@@ -476,13 +624,122 @@ namespace irlib {
             }
         }
 
-        double r = 0.0;
+        T r = 0.0;
         for (int p=0; p<=k; ++p) {
             r += rvec[p]/(p+1);
         }
         return r;
     }
 
+    /// Return the derivative of the given order as a piecewise polynomial
+    template<typename T, typename Tx>
+    piecewise_polynomial<T,Tx>
+    derivative(const piecewise_polynomial<T,Tx> &y, int order = 1) {
+        piecewise_polynomial<T,Tx> r(y);
+        r.differentiate(order);
+        return r;
+    }
+
+    /// Return the antiderivative vanishing at the left end of the domain as a piecewise polynomial
+    template<typename T, typename Tx>
+    piecewise_polynomial<T,Tx>
+    antiderivative(const piecewise_polynomial<T,Tx> &y) {
+        piecewise_polynomial<T,Tx> r(y);
+        r.antidifferentiate();
+        return r;
+    }
+
+    /// Differentiate all the piecewise polynomials in place
+    template<typename T, typename Tx>
+    void differentiate(std::vector<piecewise_polynomial<T,Tx> > &pps, int order = 1) {
+        for (auto &pp : pps) {
+            pp.differentiate(order);
+        }
+    }
+
+    /// Replace all the piecewise polynomials by their antiderivatives in place
+    template<typename T, typename Tx>
+    void antidifferentiate(std::vector<piecewise_polynomial<T,Tx> > &pps) {
+        for (auto &pp : pps) {
+            pp.antidifferentiate();
+        }
+    }
+
+    /**
+     * Compute definite integrals \int_a^b dx y_l(x) for piecewise polynomials sharing the same sections.
+     * The weights (x-x_s)^{p+1}/(p+1) are computed once and shared by all the functions.
+     * @param pps piecewise polynomials with the same sections and order
+     * @param a lower bound
+     * @param b upper bound
+     * @return integrals
+     */
+    template<typename T, typename Tx>
+    std::vector<T>
+    integrate(const std::vector<piecewise_polynomial<T,Tx> > &pps, Tx a, Tx b) {
+        if (pps.size() == 0) {
+            return std::vector<T>();
+        }
+        if (a > b) {
+            auto r = integrate(pps, b, a);
+            for (auto &v : r) {
+                v = -v;
+            }
+            return r;
+        }
+
+        const auto &y0 = pps[0];
+        const int k = y0.order();
+        for (const auto &pp : pps) {
+            if (pp.order() != k || pp.section_edges() != y0.section_edges()) {
+                throw std::runtime_error("All piecewise polynomials must have the same sections and order.");
+            }
+        }
+        if (a < y0.section_edge(0) || b > y0.section_edge(y0.num_sections())) {
+            throw std::runtime_error("Integration range is out of the domain.");
+        }
+
+        const int s_a = y0.find_section(a);
+        const int s_b = y0.find_section(b);
+
+        // weights[s][p] = \int_{max(a,x_s)}^{min(b,x_{s+1})} dx (x-x_s)^p
+        auto weights_for = [&](int s, const Tx &x_left, const Tx &x_right) {
+            std::vector<T> w(k + 1);
+            const T dx_left = detail::x_to_coeff<T>(x_left - y0.section_edge(s));
+            const T dx_right = detail::x_to_coeff<T>(x_right - y0.section_edge(s));
+            T pow_left = dx_left, pow_right = dx_right;
+            for (int p = 0; p < k + 1; ++p) {
+                w[p] = (pow_right - pow_left) / T(p + 1);
+                pow_left *= dx_left;
+                pow_right *= dx_right;
+            }
+            return w;
+        };
+
+        std::vector<std::vector<T> > weights;
+        for (int s = s_a; s <= s_b; ++s) {
+            weights.push_back(weights_for(s,
+                                          s == s_a ? a : y0.section_edge(s),
+                                          s == s_b ? b : y0.section_edge(s + 1)));
+        }
+
+        std::vector<T> r(pps.size(), T(0.0));
+        for (int l = 0; l < pps.size(); ++l) {
+            for (int s = s_a; s <= s_b; ++s) {
+                for (int p = 0; p < k + 1; ++p) {
+                    r[l] += weights[s - s_a][p] * pps[l].coefficient(s, p);
+                }
+            }
+        }
+        return r;
+    }
+
+    /// Compute the definite integral \int_a^b dx y(x)
+    template<typename T, typename Tx>
+    T
+    integrate(const piecewise_polynomial<T,Tx> &y, Tx a, Tx b) {
+        return integrate(std::vector<piecewise_polynomial<T,Tx> >{y}, a, b)[0];
+    }
+
     inline std::ostream& operator<<(std::ostream& stream, const piecewise_polynomial<double,mpfr::mpreal>& value) {
         mpfr_prec_t prec = value.section_edge(0).get_prec();
 
@@ -572,6 +829,7 @@ namespace irlib {
         Eigen::Matrix<mpfr::mpreal,Eigen::Dynamic,Eigen::Dynamic> coeff(ns,k+1);
         for (int s=0; s<ns; ++s) {
             for (int i=0; i<k+1; ++i) {
+                coeff(s, i).set_prec(prec);
                 stream >> coeff(s, i);
             }
         }
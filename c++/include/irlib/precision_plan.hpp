@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <mpreal.h>
+
+namespace irlib {
+    /**
+     * Precisions (in bits) used in the phases of the generation of a basis.
+     * A value of 0 means that the phase uses the default precision at the time it runs.
+     */
+    struct precision_plan {
+        /// Approximate positions of nodes of the highest basis function (computed in double)
+        long approximate_nodes = 0;
+        /// Matrix representation of the kernel
+        long kernel_matrix = 0;
+        /// SVD of the kernel matrix (if ScalarType is mpreal)
+        long svd = 0;
+        /// Conversion of singular vectors into piecewise polynomials; the basis functions are stored in this precision
+        long conversion = 0;
+        /// Residuals of the integral equations
+        long residual = 0;
+    };
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+    inline std::ostream &operator<<(std::ostream &os, const precision_plan &plan) {
+        os << "approximate nodes = " << plan.approximate_nodes << ", kernel matrix = " << plan.kernel_matrix
+           << ", SVD = " << plan.svd << ", conversion = " << plan.conversion << ", residual = " << plan.residual
+           << " bits";
+        return os;
+    }
+#endif
+
+    /**
+     * Choose the minimal safe precision of each phase of the generation of a basis.
+     *
+     * Singular vectors belonging to the smallest retained singular value s_min are perturbed by eps |K| / gap,
+     * where the gap to the neighboring singular values is about s_min / log(1 + Lambda).
+     * The kernel matrix, the SVD and the residuals of the integral equations (which involve 1/s_min)
+     * therefore need about log10(1/cutoff) + log10(1/r_tol) + log10(log(1 + Lambda)) digits.
+     * The conversion of Legendre coefficients into local Taylor coefficients loses about 0.77 digits
+     * per polynomial order (the growth of P_n(3)) and needs log10(1/r_tol) digits on top of that.
+     * Two guard digits are added to each phase. No phase goes below 64 bits or below prec.
+     * @param Lambda Lambda
+     * @param cutoff cutoff for singular values relative to the largest one
+     * @param r_tol relative tolerance for the basis functions
+     * @param prec minimum precision in bits
+     * @param n_local_poly maximum number of Legendre polynomials in a section
+     * @return precisions of the phases
+     */
+    inline precision_plan plan_precision(double Lambda, double cutoff, double r_tol, long prec, int n_local_poly) {
+        const double digits_cutoff = std::log10(1 / cutoff);
+        const double digits_r_tol = std::log10(1 / r_tol);
+        const double digits_gap = std::log10(1 + std::log(1 + Lambda));
+        const double guard_digits = 2;
+
+        auto to_bits = [&](double digits) {
+            return std::max(std::max(static_cast<long>(mpfr::digits2bits(static_cast<int>(std::ceil(digits)))), long(64)), prec);
+        };
+
+        precision_plan plan;
+        plan.approximate_nodes = 53;
+        plan.kernel_matrix = to_bits(digits_cutoff + digits_r_tol + digits_gap + guard_digits);
+        plan.svd = plan.kernel_matrix;
+        plan.conversion = to_bits(digits_r_tol + 0.77 * (n_local_poly - 1) + guard_digits);
+        plan.residual = to_bits(digits_cutoff + digits_r_tol + guard_digits);
+        return plan;
+    }
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+    namespace detail {
+        /// Set the default precision of mpreal while in scope (nothing is done for prec <= 0)
+        class scoped_default_prec {
+        public:
+            explicit scoped_default_prec(long prec) : prec_bak_(mpfr::mpreal::get_default_prec()) {
+                if (prec > 0) {
+                    mpfr::mpreal::set_default_prec(prec);
+                }
+            }
+
+            ~scoped_default_prec() {
+                mpfr::mpreal::set_default_prec(prec_bak_);
+            }
+
+            scoped_default_prec(const scoped_default_prec &) = delete;
+            scoped_default_prec &operator=(const scoped_default_prec &) = delete;
+
+        private:
+            mp_prec_t prec_bak_;
+        };
+    }
+#endif
+}
@@ -0,0 +1,834 @@
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/QR>
+
+#include "basis.hpp"
+#include "compressed_basis.hpp"
+#include "detail/parallel.hpp"
+
+namespace irlib {
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+    namespace detail {
+        /**
+         * Quadrature weights for integrals of f_l(x) g(x) over [-1, 1] by composite Gauss-Legendre quadrature:
+         *   int_{-1}^1 f_l(x) g(x) dx ~ sum_n W(l, n) g(x_n),  W(l, n) = f_l(x_n) w_n.
+         * f_l(x) is given on [0, 1] and f_l(-x) = (-1)^l f_l(x) is assumed.
+         * The nodes are placed in the sections of f_l(x) mirrored onto [-1, 1], in ascending order.
+         * f_l(x) is evaluated in the current default precision.
+         * @param f functions sharing the same sections and order
+         * @param num_local_nodes number of nodes in each section (a value <= 0 means the order of f_l(x) + 1)
+         * @param num_threads number of threads
+         * @param x nodes
+         * @param W weights (number of functions x number of nodes)
+         */
+        inline void quadrature_matrix(const std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> &f,
+                                      int num_local_nodes, int num_threads,
+                                      std::vector<double> &x, Eigen::MatrixXd &W) {
+            const int dim = f.size();
+            if (num_local_nodes <= 0) {
+                num_local_nodes = f[0].order() + 1;
+            }
+
+            const auto &section_edges = f[0].section_edges();
+            const int num_sec = section_edges.size() - 1;
+            // The nodes on [-1, 1] come in pairs of +-x, so they are sorted to keep the nodes in each section ascending.
+            auto local_nodes = gauss_legendre_nodes<mpfr::mpreal>(num_local_nodes);
+            std::sort(local_nodes.begin(), local_nodes.end());
+            const auto nodes = composite_gauss_legendre_nodes(section_edges, local_nodes);
+            const int num_nodes_half = nodes.size();
+
+            // Nodes in [0, 1] are mirrored onto [-1, 0] in reverse order, so that all the nodes are in ascending order.
+            x.resize(2 * num_nodes_half);
+            W.resize(dim, 2 * num_nodes_half);
+            parallel_for(num_sec, [&](int s) {
+                for (int n = s * num_local_nodes; n < (s + 1) * num_local_nodes; ++n) {
+                    const int n_plus = num_nodes_half + n;
+                    const int n_minus = num_nodes_half - 1 - n;
+                    x[n_plus] = static_cast<double>(nodes[n].first);
+                    x[n_minus] = -x[n_plus];
+                    for (int l = 0; l < dim; ++l) {
+                        const double w = static_cast<double>(f[l].compute_value(nodes[n].first, s) * nodes[n].second);
+                        W(l, n_plus) = w;
+                        W(l, n_minus) = l % 2 == 0 ? w : -w;
+                    }
+                }
+            }, num_threads);
+        }
+
+        /**
+         * Compute A * B, splitting the columns of B among threads.
+         * Each thread calls the matrix product of Eigen on a block of columns, so the throughput is that of GEMM.
+         */
+        template<typename DerivedB>
+        Eigen::MatrixXd parallel_gemm(const Eigen::MatrixXd &A, const Eigen::MatrixBase<DerivedB> &B, int num_threads) {
+            Eigen::MatrixXd C(A.rows(), B.cols());
+            if (num_threads <= 0) {
+                num_threads = default_num_threads();
+            }
+            const int num_blocks = std::max(1, std::min(num_threads, static_cast<int>(B.cols())));
+            const int block_size = (B.cols() + num_blocks - 1) / num_blocks;
+            parallel_for(num_blocks, [&](int b) {
+                const int first = b * block_size;
+                const int n = std::min(block_size, static_cast<int>(B.cols()) - first);
+                if (n > 0) {
+                    C.middleCols(first, n).noalias() = A * B.middleCols(first, n);
+                }
+            }, num_threads);
+            return C;
+        }
+    }
+#endif
+
+/**
+ * Projection of functions of x (x = 2 tau/beta - 1) onto an IR basis by composite Gauss-Legendre quadrature:
+ *   G_l = int_{-1}^1 u_l(x) G(x) dx ~ sum_n W(l, n) G(x_n),  W(l, n) = u_l(x_n) w_n.
+ * The nodes are placed in the sections of u_l(x) mirrored onto [-1, 1].
+ * With the default number of nodes, the quadrature is exact whenever G(x) is a polynomial of the order of u_l(x)
+ * in each section, e.g., any linear combination of u_l(x).
+ * W is built once in the precision of the basis. Then many components (orbitals, k points, ...) sampled at the nodes
+ * are projected at once by a matrix product of W and a (nodes x components) block.
+ */
+    class projector {
+    public:
+        projector() {}
+
+        /**
+         * Constructor
+         * @param b basis
+         * @param num_local_nodes number of Gauss-Legendre nodes in each section (a value <= 0 means the order of u_l(x) + 1)
+         * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+         */
+        explicit projector(const basis &b, int num_local_nodes = 0, int num_threads = 0) : num_threads_(num_threads) {
+            detail::scoped_default_prec scoped_prec(b.get_prec());
+            std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> ul;
+            for (int l = 0; l < b.dim(); ++l) {
+                ul.push_back(b.ul(l));
+            }
+            detail::quadrature_matrix(ul, num_local_nodes, num_threads, x_, W_);
+        }
+
+        /// Number of basis functions
+        int dim() const {
+            return W_.rows();
+        }
+
+        /// Number of sampling points
+        int num_sampling_points() const {
+            return x_.size();
+        }
+
+        /// Sampling points x_n in ascending order, at which G(x) must be given
+        std::vector<double> sampling_points() const {
+            return x_;
+        }
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+        /// Weight matrix W (dim() x num_sampling_points())
+        const Eigen::MatrixXd &weight_matrix() const {
+            return W_;
+        }
+#endif
+
+        /**
+         * Project functions onto the basis
+         * @param g values of the functions at the sampling points (num_sampling_points() x number of functions)
+         * @return expansion coefficients (dim() x number of functions)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        project(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            check_rows(g.rows());
+            return detail::parallel_gemm(W_, g, num_threads_);
+        }
+
+        /// Project complex-valued functions onto the basis (real and imaginary parts are projected separately)
+        Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic>
+        project(const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            check_rows(g.rows());
+            Eigen::MatrixXcd r(dim(), g.cols());
+            r.real() = detail::parallel_gemm(W_, g.real(), num_threads_);
+            r.imag() = detail::parallel_gemm(W_, g.imag(), num_threads_);
+            return r;
+        }
+
+    private:
+        int num_threads_ = 0;
+        std::vector<double> x_;
+        Eigen::MatrixXd W_;
+
+        void check_rows(int rows) const {
+            if (rows != num_sampling_points()) {
+                throw std::runtime_error("projector: the number of rows must be equal to the number of sampling points.");
+            }
+        }
+    };
+
+/**
+ * Synthesis of functions of x from IR coefficients: G(x) = sum_l G_l u_l(x).
+ * In each section of u_l(x), the coefficients of the local polynomials are first contracted with the IR coefficients
+ * by a matrix product, H_s(p, i) = sum_l a_{s,l,p} G_l(i), and then the value at each x is obtained by Horner's scheme
+ * over p. The section of each x is looked up only once, and the matrix u_l(x) is never formed.
+ * Sections are distributed over threads.
+ */
+    class synthesizer {
+    public:
+        synthesizer() {}
+
+        /**
+         * Constructor from a basis (the coefficients of u_l(x) are rounded to double)
+         * @param b basis
+         * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+         */
+        explicit synthesizer(const basis &b, int num_threads = 0) : num_threads_(num_threads) {
+            std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> ul;
+            for (int l = 0; l < b.dim(); ++l) {
+                ul.push_back(b.ul(l));
+            }
+            init(piecewise_polynomial_block<double>(ul));
+        }
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+        /// Constructor from a compressed basis, whose error is controlled
+        explicit synthesizer(const compressed_basis &cb, int num_threads = 0) : num_threads_(num_threads) {
+            init(cb.u_basis());
+        }
+
+        /// Constructor from u_l(x) on [0, 1] (u_l(-x) = (-1)^l u_l(x) is assumed)
+        explicit synthesizer(const piecewise_polynomial_block<double> &u_basis, int num_threads = 0) : num_threads_(num_threads) {
+            init(u_basis);
+        }
+#endif
+
+        /// Number of basis functions
+        int dim() const {
+            return dim_;
+        }
+
+        /**
+         * Compute G(x) = sum_l G_l u_l(x)
+         * @param coeff IR coefficients (dim() x number of functions)
+         * @param x points in [-1, 1]
+         * @return values of the functions (size of x x number of functions)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        synthesize(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &coeff,
+                   const std::vector<double> &x) const throw(std::runtime_error) {
+            if (coeff.rows() != dim_) {
+                throw std::runtime_error("synthesizer: the number of rows must be equal to the number of basis functions.");
+            }
+            for (auto xi : x) {
+                if (!(xi >= -1 && xi <= 1)) {
+                    throw std::runtime_error("synthesizer: x must be in [-1,1].");
+                }
+            }
+
+            // Points are grouped by section and by the sign of x
+            std::vector<std::vector<int>> points(2 * num_sections());
+            for (int i = 0; i < x.size(); ++i) {
+                points[2 * find_section(std::abs(x[i])) + (x[i] < 0 ? 1 : 0)].push_back(i);
+            }
+
+            // G_l for x < 0: u_l(-x) = (-1)^l u_l(x)
+            Eigen::MatrixXd coeff_minus(coeff);
+            for (int l = 1; l < dim_; l += 2) {
+                coeff_minus.row(l) *= -1;
+            }
+
+            Eigen::MatrixXd values(x.size(), coeff.cols());
+            detail::parallel_for(points.size(), [&](int key) {
+                if (points[key].empty()) {
+                    return;
+                }
+                const int s = key / 2;
+                const Eigen::MatrixXd H = A_[s] * (key % 2 == 0 ? coeff : coeff_minus);
+                for (int i : points[key]) {
+                    const double dx = std::abs(x[i]) - section_edges_[s];
+                    Eigen::RowVectorXd r = H.row(k_);
+                    for (int p = k_ - 1; p >= 0; --p) {
+                        r = r * dx + H.row(p);
+                    }
+                    values.row(i) = r;
+                }
+            }, num_threads_);
+            return values;
+        }
+
+        /// Compute G(x) = sum_l G_l u_l(x) for complex coefficients (real and imaginary parts are computed separately)
+        Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic>
+        synthesize(const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &coeff,
+                   const std::vector<double> &x) const throw(std::runtime_error) {
+            Eigen::MatrixXcd values(x.size(), coeff.cols());
+            values.real() = synthesize(Eigen::MatrixXd(coeff.real()), x);
+            values.imag() = synthesize(Eigen::MatrixXd(coeff.imag()), x);
+            return values;
+        }
+
+    private:
+        int num_threads_ = 0, dim_ = 0, k_ = 0;
+        std::vector<double> section_edges_;
+        /// A_[s](p, l) = a_{s,l,p}: coefficient of (x - x_s)^p of u_l(x)
+        std::vector<Eigen::MatrixXd> A_;
+
+        void init(const piecewise_polynomial_block<double> &u_basis) {
+            dim_ = u_basis.num_functions();
+            k_ = u_basis.order();
+            section_edges_ = u_basis.section_edges();
+            A_.resize(num_sections());
+            for (int s = 0; s < num_sections(); ++s) {
+                A_[s].resize(k_ + 1, dim_);
+                for (int l = 0; l < dim_; ++l) {
+                    for (int p = 0; p < k_ + 1; ++p) {
+                        A_[s](p, l) = u_basis.coefficient(s, l, p);
+                    }
+                }
+            }
+        }
+
+        int num_sections() const {
+            return section_edges_.size() - 1;
+        }
+
+        int find_section(double x) const {
+            if (x >= section_edges_.back()) {
+                return num_sections() - 1;
+            }
+            return std::upper_bound(section_edges_.begin(), section_edges_.end(), x) - section_edges_.begin() - 1;
+        }
+    };
+
+/**
+ * Triple-product tensor of an IR basis
+ *   T(l, m, n) = int_{-1}^1 u_l(x) u_m(x) u_n(x) dx,
+ * which gives the projection of the product of two expansions directly in the IR space:
+ *   (f g)_l = sum_{m,n} T(l, m, n) f_m g_n.
+ * T vanishes for odd l + m + n, and otherwise it is twice the integral over [0, 1].
+ * The integral over [0, 1] is computed exactly by Gauss-Legendre quadrature on the section mesh of u_l(x)
+ * (the integrand is a polynomial of order 3k in each section), with the values of u_l(x) computed in the precision of the basis.
+ * Slices T(l, :, :) are computed in parallel. Since the tensor costs O(L^3) memory and time,
+ * it may be cached on disk (see load_or_compute_triple_product).
+ */
+    class triple_product {
+    public:
+        triple_product() {}
+
+        /**
+         * Constructor
+         * @param b basis
+         * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+         */
+        explicit triple_product(const basis &b, int num_threads = 0)
+                : statistics_(b.get_statistics()), Lambda_(b.Lambda()), num_threads_(num_threads),
+                  sl_(fingerprint_sl(b)), section_edges_(fingerprint_section_edges(b)) {
+            const int dim = b.dim();
+            const int k = b.ul(0).order();
+            const int num_local_nodes = (3 * k) / 2 + 1;
+
+            // Values of u_l(x) at the nodes multiplied by the cubic root of the weights
+            Eigen::MatrixXd U;
+            {
+                detail::scoped_default_prec scoped_prec(b.get_prec());
+                const auto &section_edges = b.ul(0).section_edges();
+                const auto &local_nodes = detail::gauss_legendre_nodes<mpfr::mpreal>(num_local_nodes);
+                const auto nodes = composite_gauss_legendre_nodes(section_edges, local_nodes);
+                U.resize(nodes.size(), dim);
+                detail::parallel_for(section_edges.size() - 1, [&](int s) {
+                    for (int n = s * num_local_nodes; n < (s + 1) * num_local_nodes; ++n) {
+                        const mpfr::mpreal w = mpfr::cbrt(nodes[n].second);
+                        for (int l = 0; l < dim; ++l) {
+                            U(n, l) = static_cast<double>(b.ul(l).compute_value(nodes[n].first, s) * w);
+                        }
+                    }
+                }, num_threads);
+            }
+
+            T_.resize(dim);
+            detail::parallel_for(dim, [&](int l) {
+                T_[l] = 2.0 * (U.transpose() * U.col(l).asDiagonal() * U);
+                for (int m = 0; m < dim; ++m) {
+                    for (int n = (l + m + 1) % 2; n < dim; n += 2) {
+                        T_[l](m, n) = 0.0;
+                    }
+                }
+            }, num_threads);
+        }
+
+        /// Number of basis functions
+        int dim() const {
+            return T_.size();
+        }
+
+        /// Statistics of the basis
+        statistics::statistics_type get_statistics() const {
+            return statistics_;
+        }
+
+        /// Lambda of the basis
+        double Lambda() const {
+            return Lambda_;
+        }
+
+        /**
+         * Return true if the tensor was computed for the basis.
+         * The singular values and the section edges of the highest basis function are compared in double precision,
+         * so that bases with the same statistics, Lambda and dimension
+         * (e.g. generated with different numbers of Legendre polynomials or from different kernels) are distinguished.
+         * A tensor loaded from a file of version 1, which has no record of the basis, matches no basis.
+         */
+        bool matches(const basis &b) const {
+            return b.dim() == dim() && b.get_statistics() == statistics_ && b.Lambda() == Lambda_ &&
+                   fingerprint_sl(b) == sl_ && fingerprint_section_edges(b) == section_edges_;
+        }
+
+        /// Return T(l, m, n)
+        double operator()(int l, int m, int n) const {
+            assert(l >= 0 && l < dim() && m >= 0 && m < dim() && n >= 0 && n < dim());
+            return T_[l](m, n);
+        }
+
+        /// Return T(l, m, n)
+        double value(int l, int m, int n) const throw(std::runtime_error) {
+            python_runtime_check(l >= 0 && l < dim() && m >= 0 && m < dim() && n >= 0 && n < dim(), "Index is out of range.");
+            return (*this)(l, m, n);
+        }
+
+        /**
+         * Project the products of two expansions onto the basis: h_l = sum_{m,n} T(l, m, n) f_m g_n for each column
+         * @param f coefficients (dim() x number of functions)
+         * @param g coefficients (dim() x number of functions)
+         * @return coefficients of the products (dim() x number of functions)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        multiply(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &f,
+                 const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            if (f.rows() != dim() || g.rows() != dim() || f.cols() != g.cols()) {
+                throw std::runtime_error("triple_product: inconsistent sizes of coefficients.");
+            }
+            Eigen::MatrixXd h(dim(), f.cols());
+            detail::parallel_for(dim(), [&](int l) {
+                h.row(l) = f.cwiseProduct(T_[l] * g).colwise().sum();
+            }, num_threads_);
+            return h;
+        }
+
+        /// Complex version of multiply
+        Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic>
+        multiply(const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &f,
+                 const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            if (f.rows() != dim() || g.rows() != dim() || f.cols() != g.cols()) {
+                throw std::runtime_error("triple_product: inconsistent sizes of coefficients.");
+            }
+            Eigen::MatrixXcd h(dim(), f.cols());
+            detail::parallel_for(dim(), [&](int l) {
+                h.row(l) = f.cwiseProduct(T_[l].cast<std::complex<double>>() * g).colwise().sum();
+            }, num_threads_);
+            return h;
+        }
+
+        /// Save the tensor into a text file
+        void savetxt(const std::string &fname) const throw(std::runtime_error) {
+            std::ofstream ofs(fname);
+            if (!ofs.is_open()) {
+                throw std::runtime_error(fname + " cannot be opened!");
+            }
+            int version = 2;
+            ofs << version << std::endl;
+            ofs << statistics_ << std::endl;
+            ofs << std::setprecision(std::numeric_limits<double>::max_digits10);
+            ofs << Lambda_ << std::endl;
+            ofs << dim() << std::endl;
+            for (const auto &sl : sl_) {
+                ofs << sl << std::endl;
+            }
+            ofs << section_edges_.size() << std::endl;
+            for (const auto &edge : section_edges_) {
+                ofs << edge << std::endl;
+            }
+            for (int l = 0; l < dim(); ++l) {
+                for (int m = 0; m < dim(); ++m) {
+                    for (int n = 0; n < dim(); ++n) {
+                        ofs << T_[l](m, n) << std::endl;
+                    }
+                }
+            }
+        }
+
+        /// Load a tensor from a text file written by savetxt
+        static triple_product loadtxt(const std::string &fname) throw(std::runtime_error) {
+            std::ifstream ifs(fname);
+            if (!ifs.is_open()) {
+                throw std::runtime_error(fname + " cannot be opened!");
+            }
+            triple_product tp;
+            int version, s, dim;
+            ifs >> version >> s >> tp.Lambda_ >> dim;
+            if (!ifs || (version != 1 && version != 2) || dim <= 0) {
+                throw std::runtime_error(fname + " is not a valid file of a triple-product tensor.");
+            }
+            tp.statistics_ = static_cast<statistics::statistics_type>(s);
+            if (version == 2) {
+                tp.sl_.resize(dim);
+                for (int l = 0; l < dim; ++l) {
+                    ifs >> tp.sl_[l];
+                }
+                int num_edges;
+                ifs >> num_edges;
+                if (!ifs || num_edges < 2) {
+                    throw std::runtime_error(fname + " is not a valid file of a triple-product tensor.");
+                }
+                tp.section_edges_.resize(num_edges);
+                for (int i = 0; i < num_edges; ++i) {
+                    ifs >> tp.section_edges_[i];
+                }
+                if (!ifs) {
+                    throw std::runtime_error(fname + " is truncated.");
+                }
+            }
+            tp.T_.resize(dim);
+            for (int l = 0; l < dim; ++l) {
+                tp.T_[l].resize(dim, dim);
+                for (int m = 0; m < dim; ++m) {
+                    for (int n = 0; n < dim; ++n) {
+                        ifs >> tp.T_[l](m, n);
+                    }
+                }
+            }
+            if (!ifs) {
+                throw std::runtime_error(fname + " is truncated.");
+            }
+            return tp;
+        }
+
+    private:
+        statistics::statistics_type statistics_ = statistics::FERMIONIC;
+        double Lambda_ = 0.0;
+        int num_threads_ = 0;
+        /// Record of the basis (see matches)
+        std::vector<double> sl_, section_edges_;
+        /// T_[l](m, n) = T(l, m, n)
+        std::vector<Eigen::MatrixXd> T_;
+
+        static std::vector<double> fingerprint_sl(const basis &b) {
+            std::vector<double> sl(b.dim());
+            for (int l = 0; l < b.dim(); ++l) {
+                sl[l] = b.sl(l);
+            }
+            return sl;
+        }
+
+        static std::vector<double> fingerprint_section_edges(const basis &b) {
+            const auto &ul = b.ul(b.dim() - 1);
+            std::vector<double> edges(ul.num_sections() + 1);
+            for (int s = 0; s < edges.size(); ++s) {
+                edges[s] = static_cast<double>(ul.section_edge(s));
+            }
+            return edges;
+        }
+    };
+
+    /**
+     * Load the triple-product tensor of a basis from a file if the file exists and matches the basis
+     * (see triple_product::matches).
+     * Otherwise, compute the tensor and save it into the file.
+     * @param b basis
+     * @param fname file caching the tensor
+     * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+     * @return tensor
+     */
+    inline triple_product load_or_compute_triple_product(const basis &b, const std::string &fname, int num_threads = 0)
+    throw(std::runtime_error) {
+        if (std::ifstream(fname).good()) {
+            try {
+                auto tp = triple_product::loadtxt(fname);
+                if (tp.matches(b)) {
+                    return tp;
+                }
+            } catch (const std::runtime_error &) {
+                // The file is recomputed below.
+            }
+        }
+        triple_product tp(b, num_threads);
+        tp.savetxt(fname);
+        return tp;
+    }
+
+/**
+ * Discrete Lehmann representation (DLR) built from an IR basis.
+ * A Green's function is represented by the weights c_p of poles at y_p (omega_p = Lambda y_p / beta):
+ *   rho(y) = sum_p c_p delta(y - y_p),  G_l = -s_l sum_p v_l(y_p) c_p.
+ * The poles are the local extrema of the highest basis function v_{L-1}(y) in (-1, 1) and the end points y = +/-1,
+ * where the highest basis function is most sensitive to the position of a pole.
+ * The (L x number of poles) matrix is factorized by a column-pivoted QR decomposition once,
+ * so conversions in both directions cost O(L^2) per function.
+ */
+    class dlr {
+    public:
+        dlr() {}
+
+        /**
+         * Constructor
+         * @param b basis
+         */
+        explicit dlr(const basis &b) {
+            const int dim = b.dim();
+            detail::scoped_default_prec scoped_prec(b.get_prec());
+
+            const auto &v_last = b.vl(dim - 1);
+            std::set<double> poles{-1.0, 1.0};
+            for (const auto &y : find_extrema(v_last, mpfr::mpreal(1e-20))) {
+                poles.insert(static_cast<double>(y));
+                poles.insert(-static_cast<double>(y));
+            }
+            // An even function has an extremum at y = 0, which is an end point of the representation on [0, 1].
+            if ((dim - 1) % 2 == 0) {
+                poles.insert(0.0);
+            }
+            poles_.assign(poles.begin(), poles.end());
+
+            M_.resize(dim, poles_.size());
+            for (int p = 0; p < poles_.size(); ++p) {
+                for (int l = 0; l < dim; ++l) {
+                    M_(l, p) = -b.sl(l) * b.vly(l, poles_[p]);
+                }
+            }
+            qr_.compute(M_);
+        }
+
+        /// Number of basis functions
+        int dim() const {
+            return M_.rows();
+        }
+
+        /// Number of poles
+        int num_poles() const {
+            return poles_.size();
+        }
+
+        /// Positions of the poles y_p in [-1, 1] in ascending order
+        std::vector<double> poles() const {
+            return poles_;
+        }
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+        /// Transformation matrix from DLR to IR coefficients (dim() x num_poles())
+        const Eigen::MatrixXd &transformation_matrix() const {
+            return M_;
+        }
+#endif
+
+        /**
+         * Convert DLR coefficients into IR coefficients
+         * @param c weights of the poles (num_poles() x number of functions)
+         * @return IR coefficients (dim() x number of functions)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        to_ir(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &c) const throw(std::runtime_error) {
+            if (c.rows() != num_poles()) {
+                throw std::runtime_error("dlr: the number of rows must be equal to the number of poles.");
+            }
+            return M_ * c;
+        }
+
+        /// Complex version of to_ir
+        Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic>
+        to_ir(const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &c) const throw(std::runtime_error) {
+            if (c.rows() != num_poles()) {
+                throw std::runtime_error("dlr: the number of rows must be equal to the number of poles.");
+            }
+            return M_.cast<std::complex<double>>() * c;
+        }
+
+        /**
+         * Convert IR coefficients into DLR coefficients (least-squares solution)
+         * @param g IR coefficients (dim() x number of functions)
+         * @return weights of the poles (num_poles() x number of functions)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        from_ir(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            if (g.rows() != dim()) {
+                throw std::runtime_error("dlr: the number of rows must be equal to the number of basis functions.");
+            }
+            return qr_.solve(g);
+        }
+
+        /// Complex version of from_ir (real and imaginary parts are converted separately)
+        Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic>
+        from_ir(const Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic> &g) const throw(std::runtime_error) {
+            if (g.rows() != dim()) {
+                throw std::runtime_error("dlr: the number of rows must be equal to the number of basis functions.");
+            }
+            Eigen::MatrixXcd c(num_poles(), g.cols());
+            c.real() = qr_.solve(Eigen::MatrixXd(g.real()));
+            c.imag() = qr_.solve(Eigen::MatrixXd(g.imag()));
+            return c;
+        }
+
+    private:
+        std::vector<double> poles_;
+        Eigen::MatrixXd M_;
+        Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr_;
+    };
+
+/**
+ * Projection of spectral functions onto IR coefficients on the real axis (omega = Lambda y / beta):
+ *   G_l = -s_l int_{-1}^1 v_l(y) rho(y) dy ~ sum_n W(l, n) rho(y_n),  W(l, n) = -s_l v_l(y_n) w_n.
+ * The nodes are composite Gauss-Legendre nodes on the section mesh of v_l(y) mirrored onto [-1, 1].
+ * Many spectra are mapped at once by a matrix product of W and a (nodes x spectra) block.
+ * Spectra given on a user-defined grid (interpolated linearly between the grid points) or as piecewise polynomials
+ * are sampled at the nodes (or folded into W) first. Spectra given as sums of poles are mapped without quadrature.
+ */
+    class spectral_projector {
+    public:
+        spectral_projector() {}
+
+        /**
+         * Constructor
+         * @param b basis
+         * @param num_local_nodes number of Gauss-Legendre nodes in each section (a value <= 0 means the order of v_l(y) + 1)
+         * @param num_threads number of threads (a value <= 0 means the number of hardware threads)
+         */
+        explicit spectral_projector(const basis &b, int num_local_nodes = 0, int num_threads = 0) : num_threads_(num_threads) {
+            detail::scoped_default_prec scoped_prec(b.get_prec());
+            std::vector<piecewise_polynomial<mpfr::mpreal, mpfr::mpreal>> vl;
+            for (int l = 0; l < b.dim(); ++l) {
+                vl.push_back(b.vl(l));
+            }
+            detail::quadrature_matrix(vl, num_local_nodes, num_threads, y_, W_);
+            sl_.resize(b.dim());
+            for (int l = 0; l < b.dim(); ++l) {
+                sl_[l] = b.sl(l);
+                W_.row(l) *= -sl_[l];
+            }
+            v_basis_ = piecewise_polynomial_block<double>(vl);
+        }
+
+        /// Number of basis functions
+        int dim() const {
+            return W_.rows();
+        }
+
+        /// Number of sampling points
+        int num_sampling_points() const {
+            return y_.size();
+        }
+
+        /// Sampling points y_n in ascending order, at which rho(y) must be given
+        std::vector<double> sampling_points() const {
+            return y_;
+        }
+
+        /**
+         * Map spectra sampled at the sampling points to IR coefficients
+         * @param rho values of the spectra at the sampling points (num_sampling_points() x number of spectra)
+         * @return IR coefficients (dim() x number of spectra)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        project(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &rho) const throw(std::runtime_error) {
+            if (rho.rows() != num_sampling_points()) {
+                throw std::runtime_error("spectral_projector: the number of rows must be equal to the number of sampling points.");
+            }
+            return detail::parallel_gemm(W_, rho, num_threads_);
+        }
+
+        /**
+         * Weights for spectra given on a grid: G_l = sum_i B(l, i) rho(y_i).
+         * rho(y) is interpolated linearly between the grid points and vanishes outside the grid.
+         * The matrix is meant to be computed once for a grid and applied to many spectra.
+         * @param y grid points in [-1, 1] in ascending order
+         * @return B (dim() x size of y)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        grid_weights(const std::vector<double> &y) const throw(std::runtime_error) {
+            if (y.size() < 2 || !std::is_sorted(y.begin(), y.end()) || y.front() < -1 || y.back() > 1) {
+                throw std::runtime_error("spectral_projector: the grid must be sorted in [-1,1] and have at least two points.");
+            }
+            // Hat functions at the grid points evaluated at the sampling points (at most two non-zero entries per node)
+            Eigen::MatrixXd B = Eigen::MatrixXd::Zero(dim(), y.size());
+            for (int n = 0; n < y_.size(); ++n) {
+                if (y_[n] < y.front() || y_[n] > y.back()) {
+                    continue;
+                }
+                const int i = std::min(static_cast<int>(std::upper_bound(y.begin(), y.end(), y_[n]) - y.begin()) - 1,
+                                       static_cast<int>(y.size()) - 2);
+                const double t = (y_[n] - y[i]) / (y[i + 1] - y[i]);
+                B.col(i) += (1 - t) * W_.col(n);
+                B.col(i + 1) += t * W_.col(n);
+            }
+            return B;
+        }
+
+        /**
+         * Map spectra given on a grid to IR coefficients (see grid_weights)
+         * @param y grid points in [-1, 1] in ascending order
+         * @param rho values of the spectra on the grid (size of y x number of spectra)
+         * @return IR coefficients (dim() x number of spectra)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        project(const std::vector<double> &y,
+                const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &rho) const throw(std::runtime_error) {
+            if (rho.rows() != y.size()) {
+                throw std::runtime_error("spectral_projector: the number of rows must be equal to the number of grid points.");
+            }
+            return detail::parallel_gemm(grid_weights(y), rho, num_threads_);
+        }
+
+#ifndef SWIG //DO NOT EXPOSE TO PYTHON
+        /**
+         * Map spectra given as piecewise polynomials on [-1, 1] to IR coefficients
+         * @param rho spectra
+         * @return IR coefficients (dim() x number of spectra)
+         */
+        template<typename T>
+        Eigen::MatrixXd project(const std::vector<piecewise_polynomial<T, T>> &rho) const {
+            Eigen::MatrixXd rho_nodes(num_sampling_points(), rho.size());
+            detail::parallel_for(rho.size(), [&](int i) {
+                for (int n = 0; n < y_.size(); ++n) {
+                    rho_nodes(n, i) = static_cast<double>(rho[i].compute_value(static_cast<T>(y_[n])));
+                }
+            }, num_threads_);
+            return project(rho_nodes);
+        }
+#endif
+
+        /**
+         * Map spectra given as sums of poles, rho(y) = sum_p c_p delta(y - y_p), to IR coefficients:
+         *   G_l = -s_l sum_p v_l(y_p) c_p.
+         * v_l(y_p) for all l are computed with a single section lookup per pole, and the weights are contracted by one matrix product.
+         * @param poles positions of the poles y_p in [-1, 1]
+         * @param c weights of the poles (number of poles x number of spectra)
+         * @return IR coefficients (dim() x number of spectra)
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>
+        project_poles(const std::vector<double> &poles,
+                      const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &c) const throw(std::runtime_error) {
+            if (c.rows() != poles.size()) {
+                throw std::runtime_error("spectral_projector: the number of rows must be equal to the number of poles.");
+            }
+            Eigen::MatrixXd V(dim(), poles.size());
+            detail::parallel_for(poles.size(), [&](int p) {
+                if (!(poles[p] >= -1 && poles[p] <= 1)) {
+                    throw std::runtime_error("spectral_projector: poles must be in [-1,1].");
+                }
+                v_basis_.compute_values(std::abs(poles[p]), V.col(p).data());
+                for (int l = 0; l < dim(); ++l) {
+                    V(l, p) *= (poles[p] < 0 && l % 2 == 1 ? sl_[l] : -sl_[l]);
+                }
+            }, num_threads_);
+            return detail::parallel_gemm(V, c, num_threads_);
+        }
+
+    private:
+        int num_threads_ = 0;
+        std::vector<double> y_, sl_;
+        Eigen::MatrixXd W_;
+        piecewise_polynomial_block<double> v_basis_;
+    };
+}
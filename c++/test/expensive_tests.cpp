@@ -1,6 +1,9 @@
 #include "common.hpp"
+#include <irlib/batch.hpp>
 
+#include <functional>
 #include <fstream>
+#include <map>
 
 using namespace irlib;
 
@@ -97,6 +100,124 @@ TEST(kernel, SVD) {
 
 }
 
+TEST(kernel, compressed_SVD) {
+    typedef Eigen::Matrix<mpreal, Eigen::Dynamic, Eigen::Dynamic> MatrixXmp;
+    typedef Eigen::Matrix<mpreal, Eigen::Dynamic, 1> VectorXmp;
+
+    ir_set_default_prec<mpreal>(ir_digits2bits(40));
+
+    int num_sec = 10;
+    int Nl = 8;
+    double Lambda = 100.0;
+    std::vector<mpreal> section_edges = linspace<mpreal>(0, 1, num_sec + 1);
+
+    fermionic_kernel<mpreal> kernel(Lambda);
+    auto kernel_even = [&](const mpreal &x, const mpreal &y) {
+        return kernel(x, y) + kernel(x, -y);
+    };
+    MatrixXmp Kmat = matrix_rep<mpreal>(kernel_even, section_edges, section_edges, 12, Nl);
+    Eigen::BDCSVD<MatrixXmp> svd(Kmat, Eigen::ComputeThinU | Eigen::ComputeThinV);
+
+    VectorXmp svalues;
+    MatrixXmp U, V;
+    MatrixXmp Kmat_copy(Kmat);
+    detail::compressed_svd(Kmat_copy, 1e-20, svalues, U, V);
+    ASSERT_TRUE(svalues.size() < Kmat.rows());
+
+    const mpreal s0 = svd.singularValues()[0];
+    for (int l = 0; l < svalues.size(); ++l) {
+        if (svd.singularValues()[l] / s0 < 1e-12) {
+            break;
+        }
+        ASSERT_TRUE(abs(svalues[l] - svd.singularValues()[l]) < 1e-18 * s0);
+        // Singular vectors agree up to sign
+        const mpreal sign = U.col(l).dot(svd.matrixU().col(l)) > 0 ? 1 : -1;
+        ASSERT_TRUE((sign * U.col(l) - svd.matrixU().col(l)).norm() < 1e-6);
+        ASSERT_TRUE((sign * V.col(l) - svd.matrixV().col(l)).norm() < 1e-6);
+    }
+    ASSERT_TRUE((Kmat - U * svalues.asDiagonal() * V.transpose()).cwiseAbs().maxCoeff() < 1e-18 * s0);
+}
+
+TEST(kernel, compressed_basis) {
+    double Lambda = 100.0;
+    double cutoff = 1e-8;
+    double r_tol = 1e-10;
+    double compression_tol = 1e-16;
+
+    auto b = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, "mp", r_tol, 64, 10, 24, false);
+    auto b_compressed = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, "mp", r_tol, 64, 10, 24, false,
+                                      compression_tol);
+
+    // Errors are of the order of compression_tol / cutoff (see compute_basis)
+    const double tol = compression_tol / cutoff;
+    ASSERT_EQ(b_compressed.dim(), b.dim());
+    for (int l = 0; l < b.dim(); ++l) {
+        ASSERT_NEAR(b_compressed.sl(l), b.sl(l), compression_tol * b.sl(0));
+        for (double x : {-1.0, -0.5, 0.0, 0.3, 0.9, 0.99, 1.0}) {
+            ASSERT_NEAR(b_compressed.ulx(l, x), b.ulx(l, x), tol * std::max(1.0, std::abs(b.ulx(l, x))));
+            ASSERT_NEAR(b_compressed.vly(l, x), b.vly(l, x), tol * std::max(1.0, std::abs(b.vly(l, x))));
+        }
+    }
+}
+
+TEST(kernel, truncated_SVD) {
+    ir_set_default_prec<mpreal>(169);
+
+    const int N = 300;
+    const int rank = 40;
+    fermionic_kernel<mpreal> kernel(1000.0);
+    std::vector<double> x_vec, y_vec;
+    Eigen::MatrixXd K = de_mesh_kernel_matrix_even_sector(kernel, N, x_vec, y_vec);
+    Eigen::BDCSVD<Eigen::MatrixXd> svd(K, Eigen::ComputeThinU | Eigen::ComputeThinV);
+
+    Eigen::VectorXd svalues;
+    Eigen::MatrixXd U, V;
+    detail::truncated_svd(K, rank, 4, svalues, U, V);
+    ASSERT_EQ(svalues.size(), rank);
+    ASSERT_EQ(U.cols(), rank);
+    ASSERT_EQ(V.cols(), rank);
+
+    // The leading singular triplets agree with those of the full SVD (singular vectors up to sign)
+    const double s0 = svd.singularValues()[0];
+    for (int l = 0; l < rank / 2; ++l) {
+        ASSERT_NEAR(svalues[l], svd.singularValues()[l], 1e-12 * s0);
+        if (svd.singularValues()[l] / s0 < 1e-8) {
+            continue;
+        }
+        const double sign = U.col(l).dot(svd.matrixU().col(l)) > 0 ? 1 : -1;
+        ASSERT_TRUE((sign * U.col(l) - svd.matrixU().col(l)).norm() < 1e-6);
+        ASSERT_TRUE((sign * V.col(l) - svd.matrixV().col(l)).norm() < 1e-6);
+    }
+}
+
+TEST(kernel, approximate_nodes) {
+    ir_set_default_prec<mpreal>(169);
+
+    // The number of nodes agrees with that found by a full SVD on a fixed mesh of 500 points
+    const double cutoff = 1e-12;
+    for (double Lambda : {10.0, 1000.0, 10000.0}) {
+        fermionic_kernel<mpreal> kernel(Lambda);
+        std::vector<double> x_vec, y_vec;
+        Eigen::MatrixXd K = de_mesh_kernel_matrix_even_sector(kernel, 500, x_vec, y_vec);
+        Eigen::BDCSVD<Eigen::MatrixXd> svd(K);
+        const Eigen::VectorXd &svalues = svd.singularValues();
+        int dim = svalues.size();
+        for (int i = 1; i < svalues.size(); ++i) {
+            if (svalues[i] / svalues[0] < cutoff) {
+                dim = i;
+                break;
+            }
+        }
+
+        std::vector<double> nodes_x, nodes_y;
+        std::tie(nodes_x, nodes_y) = compute_approximate_nodes_even_sector(kernel, 100, cutoff);
+        ASSERT_EQ(nodes_x.size(), dim - 1);
+        ASSERT_EQ(nodes_y.size(), dim - 1);
+        ASSERT_TRUE(std::is_sorted(nodes_x.begin(), nodes_x.end()));
+        ASSERT_TRUE(std::is_sorted(nodes_y.begin(), nodes_y.end()));
+    }
+}
+
 TEST(kernel, transformation_to_matsubara) {
     int ns = 1000;
     int k = 4;
@@ -172,6 +293,56 @@ TEST(kernel, basis_functions) {
         ASSERT_NEAR(static_cast<double>(v_basis[l].overlap(v_basis[l + 2])), 0.0, 1e-10);
     }
 
+    // Residuals of the integral equation for all even l at once
+    {
+        const detail::symmetrized_kernel<fermionic_kernel<mpreal>> kernel_even(kernel, 1);
+        std::vector<pp_type> u_even, v_even;
+        std::vector<mpreal> sv_even;
+        for (int l = 0; l < sv.size(); l += 2) {
+            u_even.push_back(u_basis[l]);
+            v_even.push_back(v_basis[l]);
+            sv_even.push_back(sv[l]);
+        }
+
+        // Reference: max_x |s^{-1} int_0^1 K(x,y) v(y) dy - u(x)| at the midpoints of the sections of u,
+        // computed pointwise by composite Gauss-Legendre quadrature
+        const int num_local_nodes = 24;
+        auto reference_residual = [&](const pp_type &ux, const pp_type &vy, const mpreal &s,
+                                      const std::function<mpreal(const mpreal &, const mpreal &)> &k) {
+            auto nodes_y = composite_gauss_legendre_nodes(vy.section_edges(),
+                                                                  detail::gauss_legendre_nodes<mpreal>(num_local_nodes));
+            const auto &section_edges_x = ux.section_edges();
+            double residual = 0.0;
+            for (int i = 0; i < section_edges_x.size() - 1; ++i) {
+                mpreal x = (section_edges_x[i + 1] + section_edges_x[i]) / 2;
+                mpreal sum(0);
+                for (int n = 0; n < nodes_y.size(); ++n) {
+                    sum += nodes_y[n].second * k(x, nodes_y[n].first) * vy.compute_value(nodes_y[n].first);
+                }
+                residual = std::max(residual, static_cast<double>(mpfr::abs(sum / s - ux.compute_value(x))));
+            }
+            return residual;
+        };
+
+        // Residuals for u_l (single thread) and for v_l with the transposed kernel (several threads)
+        auto residuals_u = estimate_residuals(u_even, v_even, sv_even, kernel_even, num_local_nodes, 1);
+        auto residuals_v = estimate_residuals(v_even, u_even, sv_even,
+                                              detail::transposed_kernel<detail::symmetrized_kernel<fermionic_kernel<mpreal>>>(kernel_even),
+                                              num_local_nodes, 4);
+        ASSERT_EQ(residuals_u.size(), u_even.size());
+        ASSERT_EQ(residuals_v.size(), u_even.size());
+        ASSERT_TRUE(residuals_u[0] < 1e-5);
+        ASSERT_TRUE(residuals_v[0] < 1e-5);
+        auto k = [&](const mpreal &x, const mpreal &y) { return kernel_even(x, y); };
+        auto k_transposed = [&](const mpreal &x, const mpreal &y) { return kernel_even(y, x); };
+        for (int i = 0; i < u_even.size(); ++i) {
+            auto r_u = reference_residual(u_even[i], v_even[i], sv_even[i], k);
+            auto r_v = reference_residual(v_even[i], u_even[i], sv_even[i], k_transposed);
+            ASSERT_NEAR(residuals_u[i], r_u, 1e-8 * std::max(r_u, 1e-20));
+            ASSERT_NEAR(residuals_v[i], r_v, 1e-8 * std::max(r_v, 1e-20));
+        }
+    }
+
     // l=16 and x=0.5
     ASSERT_NEAR(static_cast<double>(u_basis[16].compute_value(0.5) / u_basis[16].compute_value(1.0)), 0.129752287857, 1e-8);
     ASSERT_NEAR(static_cast<double>(v_basis[16].compute_value(0.5) / v_basis[16].compute_value(1.0)), 0.0619868246037, 1e-8);
@@ -197,6 +368,174 @@ TEST(kernel, basis_functions) {
 }
 
 
+TEST(kernel, hp_refinement) {
+    ir_set_default_prec<mpreal>(169);
+
+    double Lambda = 100.0;
+    int max_dim = 30;
+    double r_tol = 1e-8;
+
+    fermionic_kernel<mpreal> kernel(Lambda);
+
+    // Sections with different numbers of Legendre polynomials
+    std::vector<mpreal> section_edges = linspace<mpreal>(0, 1, 4);
+    std::vector<int> num_local_poly{6, 10, 8};
+    auto const_kernel = [](const mpreal &x, const mpreal &y) { return mpreal(1.0); };
+    auto Kmat = matrix_rep<mpreal>(const_kernel, section_edges, section_edges, 12, num_local_poly, num_local_poly, 6);
+    ASSERT_EQ(Kmat.rows(), 24);
+    ASSERT_EQ(Kmat.cols(), 24);
+    ASSERT_TRUE(abs(Kmat(6, 16) - mpreal(1) / mpreal(3)) < 1e-30);
+    ASSERT_TRUE(abs(Kmat(7, 16)) < 1e-30);
+
+    std::vector<mpreal> sv, sv_hp;
+    std::vector<pp_type> u_basis, v_basis, u_basis_hp, v_basis_hp;
+    std::tie(sv, u_basis, v_basis) = generate_ir_basis_functions<mpreal>(kernel, max_dim, 1e-12, false, r_tol, 10, 24);
+    std::tie(sv_hp, u_basis_hp, v_basis_hp) = generate_ir_basis_functions<mpreal>(
+            kernel, max_dim, 1e-12, false, r_tol, 10, 24, precision_plan(), 16);
+
+    ASSERT_EQ(sv.size(), sv_hp.size());
+    ASSERT_EQ(u_basis[0].order(), 9);
+    ASSERT_TRUE(u_basis_hp[0].order() <= 15);
+    for (int l = 0; l < sv.size(); ++l) {
+        ASSERT_NEAR(static_cast<double>(sv_hp[l] / sv[l]), 1.0, 1e-10);
+        for (auto x : linspace<double>(0.0, 1.0, 11)) {
+            ASSERT_NEAR(static_cast<double>(u_basis_hp[l].compute_value(x)), static_cast<double>(u_basis[l].compute_value(x)),
+                        10 * r_tol * std::abs(static_cast<double>(u_basis[l].compute_value(1))));
+            ASSERT_NEAR(static_cast<double>(v_basis_hp[l].compute_value(x)), static_cast<double>(v_basis[l].compute_value(x)),
+                        10 * r_tol * std::abs(static_cast<double>(v_basis[l].compute_value(1))));
+        }
+    }
+
+    // Some sections are refined by raising the number of Legendre polynomials beyond 10 instead of being bisected,
+    // so fewer sections are needed than by bisection only.
+    int max_section_order = 0;
+    for (const auto &basis_hp : {u_basis_hp.back(), v_basis_hp.back()}) {
+        for (int s = 0; s < basis_hp.num_sections(); ++s) {
+            max_section_order = std::max(max_section_order, basis_hp.section_order(s));
+        }
+    }
+    ASSERT_TRUE(max_section_order > 9);
+    ASSERT_TRUE(u_basis_hp[0].num_sections() + v_basis_hp[0].num_sections() < u_basis[0].num_sections() + v_basis[0].num_sections());
+
+    // Sections are bisected only at the end point x, y = 1, so the mesh is graded towards it.
+    for (const auto &basis_hp : {u_basis_hp[0], v_basis_hp[0]}) {
+        ASSERT_TRUE(basis_hp.num_sections() > 1);
+        for (int s = 0; s < basis_hp.num_sections() - 1; ++s) {
+            ASSERT_TRUE(basis_hp.section_edge(s + 1) - basis_hp.section_edge(s) >=
+                        basis_hp.section_edge(s + 2) - basis_hp.section_edge(s + 1));
+        }
+    }
+}
+
+// Logistic kernel implemented without deriving from kernel<T> and without batch evaluation
+struct user_logistic_kernel {
+    double Lambda_;
+
+    mpreal operator()(const mpreal &x, const mpreal &y) const {
+        return mpfr::exp(-mpreal("0.5") * Lambda_ * x * y) / (2 * mpfr::cosh(mpreal("0.5") * Lambda_ * y));
+    }
+
+    statistics::statistics_type get_statistics() const {
+        return statistics::FERMIONIC;
+    }
+
+    double Lambda() const {
+        return Lambda_;
+    }
+};
+
+TEST(kernel, user_defined_kernel) {
+    ir_set_default_prec<mpreal>(169);
+
+    double Lambda = 10.0;
+    fermionic_kernel<mpreal> kernel(Lambda);
+    user_logistic_kernel user_kernel{Lambda};
+    static_assert(detail::has_batch_evaluation<fermionic_kernel<mpreal>>::value, "");
+    static_assert(!detail::has_batch_evaluation<user_logistic_kernel>::value, "");
+    static_assert(detail::is_kernel<user_logistic_kernel>::value, "");
+
+    // Batch evaluation agrees with point-by-point evaluation
+    std::vector<mpreal> x{mpreal(-1), mpreal("0.3"), mpreal(1)}, y{mpreal(-1), mpreal(0), mpreal("0.7")};
+    detail::kernel_matrix_t values, values_user;
+    detail::evaluate_kernel(kernel, x, y, values);
+    detail::evaluate_kernel(user_kernel, x, y, values_user);
+    for (int i = 0; i < x.size(); ++i) {
+        for (int j = 0; j < y.size(); ++j) {
+            ASSERT_TRUE(values(i, j) == kernel(x[i], y[j]));
+            ASSERT_TRUE(abs(values_user(i, j) - kernel(x[i], y[j])) < 1e-40);
+        }
+    }
+
+    // The batch and scalar evaluations share the branches for large |Lambda y|
+    for (double Lambda_b : {10.0, 1000.0}) {
+        fermionic_kernel<mpreal> f_kernel(Lambda_b);
+        bosonic_kernel<mpreal> b_kernel(Lambda_b);
+        detail::kernel_matrix_t values_f, values_b;
+        detail::evaluate_kernel(f_kernel, x, y, values_f);
+        detail::evaluate_kernel(b_kernel, x, y, values_b);
+        for (int i = 0; i < x.size(); ++i) {
+            for (int j = 0; j < y.size(); ++j) {
+                ASSERT_TRUE(values_f(i, j) == f_kernel(x[i], y[j]));
+                ASSERT_TRUE(values_b(i, j) == b_kernel(x[i], y[j]));
+            }
+        }
+    }
+
+    basis b = compute_basis(user_kernel, 20, 1e-8, 1e-8, 64, 10, 24, false);
+    basis b_ref = compute_basis(statistics::FERMIONIC, Lambda, 20, 1e-8, "mp", 1e-8, 64, 10, 24, false);
+    ASSERT_EQ(b.get_statistics(), statistics::FERMIONIC);
+    ASSERT_EQ(b.dim(), b_ref.dim());
+    for (int l = 0; l < b.dim(); ++l) {
+        ASSERT_NEAR(b.sl(l), b_ref.sl(l), 1e-12);
+        ASSERT_NEAR(b.ulx(l, 0.5), b_ref.ulx(l, 0.5), 1e-8);
+    }
+}
+
+TEST(basis, compute_bases) {
+    std::istringstream job_list(
+            "# statistics Lambda max_dim cutoff r_tol prec n_local_poly num_nodes_gauss_legendre\n"
+            "B 10.0 1000 1e-8 1e-8 64 10 24\n"
+            "\n"
+            "F 10.0\n"
+    );
+    auto jobs = read_basis_jobs(job_list);
+    ASSERT_EQ(jobs.size(), 2);
+    ASSERT_EQ(output_file_name(jobs[0]), "basis_b-mp-Lambda10.0.txt");
+
+    {
+        std::istringstream optional_params(
+                "F 100.0 1000 1e-8 1e-8 64 10 24 1e-16 compressed.txt\n"
+                "F 100.0 1000 1e-8 1e-8 64 10 24 1e-16\n"
+                "F 100.0 1000 1e-8 1e-8 64 10 24 basis.txt\n"
+        );
+        auto jobs_optional = read_basis_jobs(optional_params);
+        ASSERT_EQ(jobs_optional.size(), 3);
+        ASSERT_EQ(jobs_optional[0].compression_tol, 1e-16);
+        ASSERT_EQ(jobs_optional[0].output, "compressed.txt");
+        ASSERT_EQ(jobs_optional[1].compression_tol, 1e-16);
+        ASSERT_TRUE(jobs_optional[1].output.empty());
+        ASSERT_EQ(jobs_optional[2].compression_tol, 0.0);
+        ASSERT_EQ(jobs_optional[2].output, "basis.txt");
+        ASSERT_EQ(jobs[0].compression_tol, 0.0);
+    }
+
+    std::map<statistics::statistics_type, basis> results;
+    int num_failed = compute_bases(jobs, [&](const basis_job &job, const basis &b) {
+        results.insert(std::make_pair(job.statistics, b));
+    }, 2, false);
+    ASSERT_EQ(num_failed, 0);
+    ASSERT_EQ(results.size(), 2);
+
+    for (auto s : {statistics::FERMIONIC, statistics::BOSONIC}) {
+        const auto &b = results.at(s);
+        auto b_ref = loadtxt(s == statistics::FERMIONIC ? "./samples/np10/basis_f-mp-Lambda10.0.txt" : "./samples/np10/basis_b-mp-Lambda10.0.txt");
+        ASSERT_EQ(b.get_statistics(), s);
+        for (int l = 0; l < std::min(b.dim(), b_ref.dim()); ++l) {
+            ASSERT_NEAR(b.sl(l), b_ref.sl(l), 1e-8 * b_ref.sl(0));
+        }
+    }
+}
+
 TEST(kernel, Ik) {
     double x0 = 0.99;
     double x1 = 1.00;
@@ -312,6 +651,51 @@ TEST(PiecewisePolynomial, Orthogonalization) {
     EXPECT_NEAR(static_cast<double>(nfunctions[1].compute_value(x) * std::sqrt(2.0 / 3.0)), x, 1E-8);
 }
 
+TEST(PiecewisePolynomial, DifferentSections) {
+    typedef irlib::piecewise_polynomial<mpreal, mpreal> pp_type;
+    const int k = 3;
+
+    ir_set_default_prec<mpreal>(167);
+
+    // f(x) = x^3 - x on 4 sections, g(x) = 1 + 2x^2 on 3 sections
+    auto edges_f = linspace<mpreal>(-1, 1, 5);
+    auto edges_g = linspace<mpreal>(-1, 1, 4);
+    auto f_exact = [](const mpreal &x) { return x * x * x - x; };
+    auto g_exact = [](const mpreal &x) { return 1 + 2 * x * x; };
+
+    auto gen_pp = [&](const std::vector<mpreal> &edges, int a0, int a1, int a2, int a3) {
+        int ns = edges.size() - 1;
+        MatrixXmp coeff(ns, k + 1);
+        for (int s = 0; s < ns; ++s) {
+            mpreal x0 = edges[s];
+            coeff(s, 0) = a0 + a1 * x0 + a2 * x0 * x0 + a3 * x0 * x0 * x0;
+            coeff(s, 1) = a1 + 2 * a2 * x0 + 3 * a3 * x0 * x0;
+            coeff(s, 2) = a2 + 3 * a3 * x0;
+            coeff(s, 3) = a3;
+        }
+        return pp_type(ns, edges, coeff);
+    };
+    auto f = gen_pp(edges_f, 0, -1, 0, 1);
+    auto g = gen_pp(edges_g, 1, 0, 2, 0);
+
+    auto sum = f + g;
+    auto diff = f - g;
+    auto prod = multiply(f, g);
+    ASSERT_EQ(sum.num_sections(), 6);
+    ASSERT_EQ(prod.num_sections(), 6);
+    for (auto x : linspace<mpreal>(-1, 1, 41)) {
+        ASSERT_TRUE(abs(sum.compute_value(x) - (f_exact(x) + g_exact(x))) < 1e-40);
+        ASSERT_TRUE(abs(diff.compute_value(x) - (f_exact(x) - g_exact(x))) < 1e-40);
+        ASSERT_TRUE(abs(prod.compute_value(x) - f_exact(x) * g_exact(x)) < 1e-40);
+    }
+
+    // \int_{-1}^1 (x^3 - x) x dx = 2/5 - 2/3
+    auto h = gen_pp(edges_g, 0, 1, 0, 0);
+    ASSERT_NEAR(static_cast<double>(f.overlap(h)), 2.0 / 5 - 2.0 / 3, 1e-12);
+    ASSERT_NEAR(static_cast<double>(h.overlap(f)), 2.0 / 5 - 2.0 / 3, 1e-12);
+}
+
+
 
 
 TEST(computeTnl, NegativeFreq) {
@@ -412,6 +796,68 @@ TEST(ComparisonMPvsDP, Fermion) {
 }
 */
 
+TEST(ComparisonMPvsMultiDouble, Fermion) {
+    double Lambda = 10.0;
+    double cutoff = 1e-12;
+    auto basis_mp = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, "mp", 1e-8, 64, 10, 24, false);
+
+    for (auto fp_mode : std::vector<std::string>{"dd", "qd"}) {
+        auto basis_md = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, fp_mode, 1e-8, 64, 10, 24, false);
+        ASSERT_EQ(basis_md.dim(), basis_mp.dim());
+
+        for (int l = 0; l < basis_mp.dim(); ++l) {
+            ASSERT_NEAR(basis_md.sl(l), basis_mp.sl(l), 1e-12 * basis_mp.sl(0));
+            for (auto x : irlib::linspace<double>(-1.0, 1.0, 21)) {
+                ASSERT_NEAR(basis_md.ulx(l, x), basis_mp.ulx(l, x), 1e-6 * std::max(1.0, std::abs(basis_mp.ulx(l, x))));
+                ASSERT_NEAR(basis_md.vly(l, x), basis_mp.vly(l, x), 1e-6 * std::max(1.0, std::abs(basis_mp.vly(l, x))));
+            }
+        }
+    }
+}
+
+TEST(basis, precision_plan) {
+    double Lambda = 10.0;
+    double cutoff = 1e-10;
+    double r_tol = 1e-8;
+
+    auto plan = plan_precision(Lambda, cutoff, r_tol, 64, 10);
+    ASSERT_EQ(plan.svd, plan.kernel_matrix);
+    ASSERT_TRUE(plan.conversion < plan.kernel_matrix);
+    ASSERT_TRUE(plan.residual <= plan.kernel_matrix);
+    ASSERT_TRUE(plan.kernel_matrix >= mpfr::digits2bits(18));
+
+    auto basis_planned = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, "mp", r_tol, 64, 10, 24, false);
+    ASSERT_EQ(basis_planned.get_precision_plan().kernel_matrix, plan.kernel_matrix);
+    ASSERT_EQ(basis_planned.get_prec(), plan.conversion);
+
+    // The plan is saved with the basis
+    {
+        const std::string fname = "precision_plan_test.txt";
+        savetxt(fname, basis_planned);
+        auto plan_loaded = loadtxt(fname).get_precision_plan();
+        std::remove(fname.c_str());
+        ASSERT_EQ(plan_loaded.approximate_nodes, plan.approximate_nodes);
+        ASSERT_EQ(plan_loaded.kernel_matrix, plan.kernel_matrix);
+        ASSERT_EQ(plan_loaded.svd, plan.svd);
+        ASSERT_EQ(plan_loaded.conversion, plan.conversion);
+        ASSERT_EQ(plan_loaded.residual, plan.residual);
+    }
+
+    // All phases in high precision
+    auto basis_high = compute_basis(statistics::FERMIONIC, Lambda, 1000, cutoff, "mp", r_tol, 256, 10, 24, false);
+    ASSERT_EQ(basis_high.get_precision_plan().conversion, 256);
+    ASSERT_EQ(basis_high.get_precision_plan().kernel_matrix, 256);
+
+    ASSERT_EQ(basis_planned.dim(), basis_high.dim());
+    for (int l = 0; l < basis_high.dim(); ++l) {
+        ASSERT_NEAR(basis_planned.sl(l), basis_high.sl(l), 1e-12 * basis_high.sl(0));
+        for (auto x : irlib::linspace<double>(-1.0, 1.0, 21)) {
+            ASSERT_NEAR(basis_planned.ulx(l, x), basis_high.ulx(l, x), r_tol * std::max(1.0, std::abs(basis_high.ulx(l, x))));
+            ASSERT_NEAR(basis_planned.vly(l, x), basis_high.vly(l, x), r_tol * std::max(1.0, std::abs(basis_high.vly(l, x))));
+        }
+    }
+}
+
 template<class T>
 class ExpansionByIRBasis : public testing::Test {
 };
@@ -3,11 +3,13 @@
 #include <fstream>
 #include <utility>
 #include <iomanip>
+#include <thread>
 
 #include <Eigen/MPRealSupport>
 #include <Eigen/SVD>
 #include <irlib/common.hpp>
-#include <irlib/detail/gauss_legendre.hpp>
+#include <irlib/multi_double.hpp>
+#include <irlib/detail/gauss_legendre_cache.hpp>
 #include <irlib/detail/legendre_polynomials.hpp>
 
 using namespace irlib;
@@ -49,6 +51,67 @@ TEST(mpmath, SVD) {
     ASSERT_TRUE((A - A_reconst).cwiseAbs().maxCoeff() < 1e-40);
 }
 
+template<typename T>
+void test_multi_double(int digits) {
+    ir_set_default_prec<mpreal>(300);
+    const mpreal eps = pow(mpreal(10), -digits);
+
+    mpreal a = mpreal(1) / mpreal(3), b = -sqrt(mpreal(2)) * mpreal(1000);
+    T ta(a), tb(b);
+    ASSERT_TRUE(abs(static_cast<mpreal>(ta) - a) < eps * abs(a));
+    ASSERT_TRUE(abs(static_cast<mpreal>(ta + tb) - (a + b)) < eps * abs(a + b));
+    ASSERT_TRUE(abs(static_cast<mpreal>(ta - tb) - (a - b)) < eps * abs(a - b));
+    ASSERT_TRUE(abs(static_cast<mpreal>(ta * tb) - (a * b)) < eps * abs(a * b));
+    ASSERT_TRUE(abs(static_cast<mpreal>(ta / tb) - (a / b)) < eps * abs(a / b));
+    ASSERT_TRUE(abs(static_cast<mpreal>(sqrt(ta)) - sqrt(a)) < eps * sqrt(a));
+    ASSERT_TRUE(tb < ta);
+    ASSERT_TRUE(abs(tb) == -tb);
+    ASSERT_TRUE(T(0.5) + T(0.5) == T(1));
+
+    // Infinities are propagated as in double
+    const T inf = T(1) / T(0);
+    ASSERT_TRUE(isinf(inf) && inf > T(0));
+    ASSERT_TRUE(isinf(inf + T(1)));
+    ASSERT_TRUE(isinf(T(1e300) * T(1e300)));
+    ASSERT_TRUE(T(1) / inf == T(0));
+
+    // SVD of a Hilbert matrix
+    typedef Eigen::Matrix<T,Eigen::Dynamic,Eigen::Dynamic> matrix_t;
+    int N = 10;
+    MatrixXmp A(N, N);
+    matrix_t A_t(N, N);
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            A(i, j) = mpreal(1) / mpreal(i + j + 1);
+            A_t(i, j) = static_cast<T>(A(i, j));
+        }
+    }
+    Eigen::BDCSVD<MatrixXmp> svd(A);
+    Eigen::BDCSVD<matrix_t> svd_t(A_t, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    matrix_t A_reconst = svd_t.matrixU() * svd_t.singularValues().asDiagonal() * svd_t.matrixV().transpose();
+    ASSERT_TRUE(static_cast<mpreal>((A_t - A_reconst).cwiseAbs().maxCoeff()) < 10 * eps);
+    for (int i = 0; i < N; ++i) {
+        ASSERT_TRUE(abs(static_cast<mpreal>(svd_t.singularValues()[i]) - svd.singularValues()[i]) < 10 * eps);
+    }
+
+    // Matrix with repeated singular values and zero entries
+    matrix_t B(N, N);
+    B.setZero();
+    for (int i = 0; i < N; ++i) {
+        B(i, i) = i < N / 2 ? 1.0 : static_cast<double>(i);
+        B(0, i) = i % 3 == 0 ? 1.0 : 0.0;
+    }
+    Eigen::BDCSVD<matrix_t> svd_B(B, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    matrix_t B_reconst = svd_B.matrixU() * svd_B.singularValues().asDiagonal() * svd_B.matrixV().transpose();
+    ASSERT_TRUE(static_cast<mpreal>((B - B_reconst).cwiseAbs().maxCoeff()) < 100 * eps);
+    ir_set_default_prec<mpreal>(167);
+}
+
+TEST(mpmath, multi_double) {
+    test_multi_double<dd_real>(30);
+    test_multi_double<qd_real>(60);
+}
+
 TEST(mpmath, gauss_legenre) {
     ir_set_default_prec<mpreal>(167);
 
@@ -64,6 +127,67 @@ TEST(mpmath, gauss_legenre) {
     }
 }
 
+TEST(mpmath, gauss_legenre_cache) {
+    ir_set_default_prec<mpreal>(167);
+    const auto &nodes = irlib::detail::gauss_legendre_nodes<mpreal>(24);
+    ASSERT_EQ(&nodes, &irlib::detail::gauss_legendre_nodes<mpreal>(24));
+    ASSERT_EQ(nodes[0].first.get_prec(), 167);
+
+    // Different precisions are cached separately.
+    ir_set_default_prec<mpreal>(300);
+    const auto &nodes_300 = irlib::detail::gauss_legendre_nodes<mpreal>(24);
+    ASSERT_NE(&nodes, &nodes_300);
+    ASSERT_EQ(nodes_300[0].first.get_prec(), 300);
+
+    // Concurrent accesses
+    std::vector<const std::vector<std::pair<double,double>>*> ptrs(4);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ptrs.size(); ++i) {
+        threads.push_back(std::thread([&ptrs, i]() { ptrs[i] = &irlib::detail::gauss_legendre_nodes<double>(48); }));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < ptrs.size(); ++i) {
+        ASSERT_EQ(ptrs[i], ptrs[0]);
+    }
+    ir_set_default_prec<mpreal>(167);
+}
+
+TEST(mpmath, gauss_legenre_newton) {
+    ir_set_default_prec<mpreal>(167);
+
+    // Agree with the hardcoded table
+    auto nodes = irlib::detail::gauss_legendre_nodes_newton<mpreal>(24);
+    auto nodes_table = irlib::detail::gauss_legendre_nodes_table<mpreal>(24);
+    for (int i = 0; i < 24; ++i) {
+        ASSERT_TRUE(abs(nodes[i].first - nodes_table[i].first) < 1e-48);
+        ASSERT_TRUE(abs(nodes[i].second - nodes_table[i].second) < 1e-48);
+    }
+
+    // Rules with n nodes are exact for x^(2n-2), including odd n and precisions beyond the tables.
+    for (int prec : {167, 1500}) {
+        ir_set_default_prec<mpreal>(prec);
+        for (int n : {1, 7, 24, 31}) {
+            const auto &nodes_n = irlib::detail::gauss_legendre_nodes<mpreal>(n);
+            ASSERT_EQ(nodes_n.size(), n);
+            mpreal sum = 0.0;
+            for (const auto &node : nodes_n) {
+                sum += pow(node.first, 2 * n - 2) * node.second;
+            }
+            ASSERT_TRUE(abs(sum - mpreal(2) / mpreal(2 * n - 1)) < 10 * std::numeric_limits<mpreal>::epsilon());
+        }
+    }
+
+    auto nodes_double = irlib::detail::gauss_legendre_nodes<double>(10);
+    double sum = 0.0;
+    for (const auto &node : nodes_double) {
+        sum += std::pow(node.first, 18) * node.second;
+    }
+    ASSERT_NEAR(sum, 2.0 / 19.0, 1e-14);
+    ir_set_default_prec<mpreal>(167);
+}
+
 TEST(mpmath, legendre_polynomials) {
     ir_set_default_prec<mpreal>(167);
 
@@ -85,6 +209,25 @@ TEST(mpmath, legendre_polynomials) {
     }
 }
 
+TEST(mpmath, normalized_legendre_polynomials_all) {
+    ir_set_default_prec<mpreal>(167);
+
+    int Nl = 20;
+    std::vector<mpreal> x{mpreal(-1), mpreal("-0.3"), mpreal(0), mpreal("0.7"), mpreal(1)};
+
+    Eigen::Matrix<mpreal,Eigen::Dynamic,Eigen::Dynamic> vals, derivs;
+    irlib::normalized_legendre_p_all(Nl, x, vals, &derivs);
+    ASSERT_EQ(vals.rows(), Nl);
+    ASSERT_EQ(vals.cols(), x.size());
+
+    auto deriv_xm1 = irlib::normalized_legendre_p_derivatives(Nl, mpreal(-1));
+    for (int l = 0; l < Nl; ++l) {
+        for (int n = 0; n < x.size(); ++n) {
+            ASSERT_TRUE(abs(vals(l, n) - irlib::normalized_legendre_p(l, x[n])) < 1e-40);
+        }
+        ASSERT_TRUE(abs(derivs(l, 0) - deriv_xm1[l][1]) < 1e-30);
+    }
+}
 
 TEST(mpmath, normalized_legendre_polynomials_derivatives) {
     ir_set_default_prec<mpreal>(167);
@@ -110,6 +253,32 @@ TEST(mpmath, normalized_legendre_polynomials_derivatives) {
 
 }
 
+TEST(mpmath, normalized_legendre_polynomials_derivatives_endpoint) {
+    ir_set_default_prec<mpreal>(167);
+
+    int Nl = 12;
+    for (int x : {-1, 1}) {
+        const auto &deriv = irlib::normalized_legendre_p_derivatives_endpoint<mpreal>(Nl, x);
+        ASSERT_EQ(&deriv, &irlib::normalized_legendre_p_derivatives_endpoint<mpreal>(Nl, x));
+        auto deriv_ref = irlib::normalized_legendre_p_derivatives(Nl, mpreal(x));
+        for (int l = 0; l < Nl; ++l) {
+            for (int d = 0; d < Nl; ++d) {
+                ASSERT_TRUE(abs(deriv[l][d] - deriv_ref[l][d]) < 1e-40 * (1 + abs(deriv_ref[l][d])));
+            }
+        }
+    }
+
+    // First derivatives at an inner point
+    std::vector<mpreal> x{mpreal("0.3")};
+    Eigen::Matrix<mpreal,Eigen::Dynamic,Eigen::Dynamic> vals, derivs;
+    irlib::normalized_legendre_p_all(Nl, x, vals, &derivs);
+    auto deriv = irlib::normalized_legendre_p_derivatives(Nl, x[0]);
+    for (int l = 0; l < Nl; ++l) {
+        ASSERT_TRUE(abs(deriv[l][0] - vals(l, 0)) < 1e-40);
+        ASSERT_TRUE(abs(deriv[l][1] - derivs(l, 0)) < 1e-40);
+    }
+}
+
 /*
 TEST(mpmath, io) {
     ir_set_default_prec<mpreal>(200);
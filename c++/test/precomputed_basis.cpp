@@ -1,4 +1,6 @@
 #include "common.hpp"
+#include <irlib/compressed_basis.hpp>
+#include <irlib/transform.hpp>
 
 #include <fstream>
 
@@ -150,3 +152,357 @@ TEST(precomputed_basis, Tnl_high_freq_limit) {
 
     }
 }
+
+TEST(precomputed_basis, find_zeros) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda1000.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    auto dim = b.dim();
+
+    for (int l : std::vector<int>{dim-2, dim-1}) {
+        // u_l(x) has l zeros in (-1,1), one of which is located at x=0 for odd l.
+        auto zeros = find_zeros(b.ul(l), mpreal(1e-20));
+        ASSERT_EQ(zeros.size(), l/2);
+        for (auto x : zeros) {
+            ASSERT_TRUE(abs(b.ul(l).compute_value(x)) < 1e-15);
+        }
+
+        // u_l(x) has a local extremum between two successive zeros.
+        auto extrema = find_extrema(b.ul(l), mpreal(1e-20));
+        ASSERT_TRUE(extrema.size() >= zeros.size()-1);
+        for (auto x : extrema) {
+            ASSERT_TRUE(abs(b.ul(l).derivative(x, 1)) < 1e-15 * abs(b.ul(l).derivative(1, 1)));
+        }
+    }
+}
+
+TEST(precomputed_basis, calculus) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda1000.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    auto dim = b.dim();
+
+    std::vector<piecewise_polynomial<mpreal,mpreal>> ul;
+    for (int l = 0; l < dim; ++l) {
+        ul.push_back(b.ul(l));
+    }
+
+    auto dul = ul;
+    differentiate(dul, 2);
+    auto Ul = ul;
+    antidifferentiate(Ul);
+
+    mpreal a("0.1"), c("0.95");
+    auto integrals = integrate(ul, a, c);
+    auto xs = linspace<mpreal>(0, 1, 21);
+    for (int l = 0; l < dim; ++l) {
+        for (auto x : xs) {
+            ASSERT_TRUE(abs(dul[l].compute_value(x) - ul[l].derivative(x, 2)) < 1e-15 * abs(ul[l].derivative(1, 2)));
+        }
+
+        // Antiderivatives are continuous across sections
+        for (int s = 1; s < Ul[l].num_sections(); ++s) {
+            auto x = Ul[l].section_edge(s);
+            ASSERT_TRUE(abs(Ul[l].compute_value(x, s-1) - Ul[l].compute_value(x, s)) < 1e-20);
+        }
+
+        ASSERT_TRUE(abs(Ul[l].compute_value(1) - integrate(ul[l])) < 1e-20);
+        ASSERT_TRUE(abs(Ul[l].compute_value(c) - Ul[l].compute_value(a) - integrals[l]) < 1e-20);
+        ASSERT_TRUE(abs(integrate(ul[l], c, a) + integrals[l]) < 1e-20);
+    }
+}
+
+TEST(precomputed_basis, overlap_matrix) {
+    auto b1 = loadtxt("./samples/np8/basis_f-mp-Lambda1000.0.txt");
+    auto b2 = loadtxt("./samples/np10/basis_f-mp-Lambda100.0.txt");
+    ir_set_default_prec<mpreal>(b1.get_prec());
+
+    std::vector<piecewise_polynomial<mpreal,mpreal>> u1, u2;
+    for (int l = 0; l < b1.dim(); ++l) {
+        u1.push_back(b1.ul(l));
+    }
+    for (int l = 0; l < b2.dim(); ++l) {
+        u2.push_back(b2.ul(l));
+    }
+
+    // u_l(x) are orthonormal on [-1,1], and thus the overlap on [0,1] is 1/2 for the same parity.
+    auto S11 = overlap_matrix(u1, u1, 2);
+    for (int l = 0; l < b1.dim(); ++l) {
+        for (int l2 = l; l2 < b1.dim(); l2 += 2) {
+            ASSERT_NEAR(static_cast<double>(S11(l, l2)), l == l2 ? 0.5 : 0.0, 1e-10);
+        }
+    }
+
+    auto S12 = overlap_matrix(u1, u2, 2);
+    ASSERT_EQ(S12.rows(), b1.dim());
+    ASSERT_EQ(S12.cols(), b2.dim());
+    for (int l = 0; l < b1.dim(); l += 3) {
+        for (int l2 = 0; l2 < b2.dim(); l2 += 3) {
+            ASSERT_NEAR(static_cast<double>(S12(l, l2)), static_cast<double>(u1[l].overlap(u2[l2])), 1e-12);
+        }
+    }
+}
+
+TEST(precomputed_basis, cspline_approximation) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda100.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+
+    std::vector<piecewise_polynomial<mpreal,mpreal>> ul;
+    for (int l = 0; l < b.dim(); ++l) {
+        ul.push_back(b.ul(l));
+    }
+
+    double r_tol = 1e-4;
+    auto ul_cspline = cspline_approximation(ul, r_tol);
+    ASSERT_EQ(ul_cspline.size(), b.dim());
+
+    // Splines constructed at once agree with those constructed one by one.
+    std::vector<mpreal> x = ul_cspline[0].section_edges();
+    for (int l = 0; l < b.dim(); l += 5) {
+        std::vector<mpreal> y;
+        for (auto xi : x) {
+            y.push_back(ul[l].compute_value(xi));
+        }
+        auto cspline = construct_piecewise_polynomial_cspline<mpreal>(x, y);
+        for (int s = 0; s < cspline.num_sections(); ++s) {
+            for (int p = 0; p < 4; ++p) {
+                ASSERT_TRUE(abs(cspline.coefficient(s, p) - ul_cspline[l].coefficient(s, p)) < 1e-15 * (1 + abs(cspline.coefficient(s, p))));
+            }
+        }
+    }
+
+    auto l = b.dim() - 1;
+    for (auto xi : linspace<mpreal>(0, 1, 101)) {
+        ASSERT_NEAR(static_cast<double>(ul_cspline[l].compute_value(xi)), static_cast<double>(ul[l].compute_value(xi)),
+                    10 * r_tol * static_cast<double>(ul[l].compute_value(1)));
+    }
+}
+
+TEST(precomputed_basis, compressed_basis) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda1000.0.txt");
+
+    for (int order : {3, 5}) {
+        double r_tol = 1e-10;
+        auto cb = compress(b, r_tol, order, 2);
+        ASSERT_EQ(cb.dim(), b.dim());
+        ASSERT_EQ(cb.u_basis().order(), order);
+        ASSERT_TRUE(cb.max_rel_error() <= r_tol);
+
+        std::vector<double> values(cb.dim());
+        for (auto x : linspace<double>(-1, 1, 1001)) {
+            cb.ulx_all(x, &values[0]);
+            for (int l = 0; l < b.dim(); ++l) {
+                ASSERT_NEAR(values[l], b.ulx(l, x), 2 * r_tol * std::abs(b.ulx(l, 1.0)));
+                ASSERT_EQ(values[l], cb.ulx(l, x));
+            }
+            cb.vly_all(x, &values[0]);
+            for (int l = 0; l < b.dim(); ++l) {
+                ASSERT_NEAR(values[l], b.vly(l, x), 2 * r_tol * std::max(std::abs(b.vly(l, 0.0)), std::abs(b.vly(l, 1.0))));
+            }
+        }
+    }
+
+    ASSERT_THROW(compress(b, 1e-16), std::runtime_error);
+}
+
+TEST(precomputed_basis, projector) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda1000.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    const int dim = b.dim();
+
+    projector proj(b, 0, 2);
+    ASSERT_EQ(proj.dim(), dim);
+    auto x = proj.sampling_points();
+    ASSERT_TRUE(std::is_sorted(x.begin(), x.end()));
+
+    // G(x) = sum_l c_l u_l(x) for a few components
+    const int num_components = 3;
+    Eigen::MatrixXd coeff = Eigen::MatrixXd::Random(dim, num_components);
+    Eigen::MatrixXd g = Eigen::MatrixXd::Zero(x.size(), num_components);
+    for (int n = 0; n < x.size(); ++n) {
+        for (int l = 0; l < dim; ++l) {
+            g.row(n) += b.ulx(l, x[n]) * coeff.row(l);
+        }
+    }
+
+    Eigen::MatrixXd coeff_proj = proj.project(g);
+    ASSERT_TRUE((coeff_proj - coeff).cwiseAbs().maxCoeff() < 1e-10);
+
+    Eigen::MatrixXcd gc = g.cast<std::complex<double>>() * std::complex<double>(1.0, -2.0);
+    Eigen::MatrixXcd coeff_proj_c = proj.project(gc);
+    ASSERT_TRUE((coeff_proj_c - coeff.cast<std::complex<double>>() * std::complex<double>(1.0, -2.0)).cwiseAbs().maxCoeff() < 1e-10);
+}
+
+TEST(precomputed_basis, synthesizer) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda1000.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    const int dim = b.dim();
+
+    const int num_components = 3;
+    Eigen::MatrixXd coeff = Eigen::MatrixXd::Random(dim, num_components);
+    auto x = linspace<double>(-1, 1, 201);
+    x.push_back(0.3);
+
+    Eigen::MatrixXd g_ref = Eigen::MatrixXd::Zero(x.size(), num_components);
+    for (int i = 0; i < x.size(); ++i) {
+        for (int l = 0; l < dim; ++l) {
+            g_ref.row(i) += b.ulx(l, x[i]) * coeff.row(l);
+        }
+    }
+    const double scale = g_ref.cwiseAbs().maxCoeff();
+
+    synthesizer synth(b, 2);
+    ASSERT_EQ(synth.dim(), dim);
+    ASSERT_TRUE((synth.synthesize(coeff, x) - g_ref).cwiseAbs().maxCoeff() < 1e-10 * scale);
+
+    synthesizer synth_compressed(compress(b, 1e-12), 2);
+    ASSERT_TRUE((synth_compressed.synthesize(coeff, x) - g_ref).cwiseAbs().maxCoeff() < 1e-9 * scale);
+
+    const std::complex<double> z(0.5, 2.0);
+    Eigen::MatrixXcd gc = synth.synthesize(Eigen::MatrixXcd(coeff.cast<std::complex<double>>() * z), x);
+    ASSERT_TRUE((gc - g_ref.cast<std::complex<double>>() * z).cwiseAbs().maxCoeff() < 1e-10 * scale);
+
+    // Synthesis after projection gives back the original function
+    projector proj(b);
+    auto xs = proj.sampling_points();
+    Eigen::MatrixXd g_nodes = synth.synthesize(coeff, xs);
+    ASSERT_TRUE((proj.project(g_nodes) - coeff).cwiseAbs().maxCoeff() < 1e-10);
+}
+
+TEST(precomputed_basis, triple_product) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda100.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    const int dim = b.dim();
+
+    triple_product tp(b, 2);
+    ASSERT_EQ(tp.dim(), dim);
+    for (int l = 0; l < dim; l += 3) {
+        for (int m = 0; m < dim; m += 2) {
+            for (int n = 0; n < dim; n += 5) {
+                ASSERT_NEAR(tp(l, m, n), tp(m, l, n), 1e-12);
+                ASSERT_NEAR(tp(l, m, n), tp(l, n, m), 1e-12);
+                if ((l + m + n) % 2 == 1) {
+                    ASSERT_EQ(tp(l, m, n), 0.0);
+                }
+            }
+        }
+    }
+
+    // Products projected by quadrature that is exact for the product of three basis functions
+    const int num_components = 2;
+    Eigen::MatrixXd f = Eigen::MatrixXd::Random(dim, num_components);
+    Eigen::MatrixXd g = Eigen::MatrixXd::Random(dim, num_components);
+    projector proj(b, (3 * b.ul(0).order()) / 2 + 1);
+    synthesizer synth(b);
+    auto x = proj.sampling_points();
+    Eigen::MatrixXd fg = synth.synthesize(f, x).cwiseProduct(synth.synthesize(g, x));
+    ASSERT_TRUE((tp.multiply(f, g) - proj.project(fg)).cwiseAbs().maxCoeff() < 1e-8);
+
+    // Cache on disk
+    const std::string fname = "triple_product_test.txt";
+    std::remove(fname.c_str());
+    auto tp_saved = load_or_compute_triple_product(b, fname, 2);
+    auto tp_loaded = load_or_compute_triple_product(b, fname, 2);
+    ASSERT_EQ(tp_loaded.dim(), dim);
+    for (int l = 0; l < dim; l += 3) {
+        ASSERT_EQ(tp_loaded(l, 1, 2), tp_saved(l, 1, 2));
+        ASSERT_EQ(tp_loaded(l, 2, 2), tp(l, 2, 2));
+    }
+    ASSERT_TRUE(tp_loaded.matches(b));
+
+    // A basis with the same statistics, Lambda and dimension but a different mesh does not use the cache
+    auto b_np8 = loadtxt("./samples/np8/basis_f-mp-Lambda100.0.txt");
+    ASSERT_EQ(b_np8.dim(), dim);
+    ASSERT_FALSE(tp_loaded.matches(b_np8));
+    auto tp_np8 = load_or_compute_triple_product(b_np8, fname, 2);
+    ASSERT_TRUE(tp_np8.matches(b_np8));
+    ASSERT_TRUE(triple_product::loadtxt(fname).matches(b_np8));
+    ASSERT_FALSE(triple_product::loadtxt(fname).matches(b));
+
+    // A corrupt file is rejected and recomputed
+    {
+        std::ofstream ofs(fname);
+        ofs << "2\n0\n100\n-3\n";
+    }
+    ASSERT_THROW(triple_product::loadtxt(fname), std::runtime_error);
+    auto tp_recomputed = load_or_compute_triple_product(b, fname, 2);
+    ASSERT_EQ(tp_recomputed(2, 1, 1), tp(2, 1, 1));
+    std::remove(fname.c_str());
+}
+
+TEST(precomputed_basis, dlr) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda100.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    const int dim = b.dim();
+
+    dlr d(b);
+    ASSERT_TRUE(std::abs(d.num_poles() - dim) <= 3);
+    auto poles = d.poles();
+    ASSERT_TRUE(std::is_sorted(poles.begin(), poles.end()));
+    ASSERT_EQ(poles.front(), -1.0);
+    ASSERT_EQ(poles.back(), 1.0);
+
+    // G_l of a few poles
+    const int num_components = 2;
+    Eigen::MatrixXd c = Eigen::MatrixXd::Random(d.num_poles(), num_components);
+    Eigen::MatrixXd g = d.to_ir(c);
+    for (int l = 0; l < dim; l += 4) {
+        double r = 0.0;
+        for (int p = 0; p < d.num_poles(); ++p) {
+            r += -b.sl(l) * b.vly(l, poles[p]) * c(p, 0);
+        }
+        ASSERT_NEAR(g(l, 0), r, 1e-12);
+    }
+
+    // Round trip through the DLR
+    ASSERT_TRUE((d.to_ir(d.from_ir(g)) - g).cwiseAbs().maxCoeff() < 1e-10 * g.cwiseAbs().maxCoeff());
+
+    Eigen::MatrixXcd gc = g.cast<std::complex<double>>() * std::complex<double>(0.0, 1.0);
+    ASSERT_TRUE((d.to_ir(d.from_ir(gc)) - gc).cwiseAbs().maxCoeff() < 1e-10 * g.cwiseAbs().maxCoeff());
+}
+
+TEST(precomputed_basis, spectral_projector) {
+    auto b = loadtxt("./samples/np10/basis_f-mp-Lambda100.0.txt");
+    ir_set_default_prec<mpreal>(b.get_prec());
+    const int dim = b.dim();
+
+    spectral_projector proj(b, 0, 2);
+    ASSERT_EQ(proj.dim(), dim);
+
+    // rho(y) = v_0(y) gives G_l = -s_0 delta_{l0} (v_l(y) are orthonormal on [-1, 1])
+    auto y = proj.sampling_points();
+    Eigen::MatrixXd rho(y.size(), 1);
+    for (int n = 0; n < y.size(); ++n) {
+        rho(n, 0) = b.vly(0, y[n]);
+    }
+    Eigen::MatrixXd g = proj.project(rho);
+    for (int l = 0; l < dim; ++l) {
+        ASSERT_NEAR(g(l, 0), l == 0 ? -b.sl(0) : 0.0, 1e-10);
+    }
+
+    // Smooth spectra given on a fine grid and as piecewise polynomials: rho(y) = 3(1 - y^2)/4 and y rho(y)
+    auto grid = linspace<double>(-1, 1, 4001);
+    Eigen::MatrixXd rho_grid(grid.size(), 2), rho_nodes(y.size(), 2);
+    for (int i = 0; i < grid.size(); ++i) {
+        rho_grid(i, 0) = 0.75 * (1 - grid[i] * grid[i]);
+        rho_grid(i, 1) = grid[i] * rho_grid(i, 0);
+    }
+    for (int n = 0; n < y.size(); ++n) {
+        rho_nodes(n, 0) = 0.75 * (1 - y[n] * y[n]);
+        rho_nodes(n, 1) = y[n] * rho_nodes(n, 0);
+    }
+    Eigen::MatrixXd g_nodes = proj.project(rho_nodes);
+    ASSERT_TRUE((proj.project(grid, rho_grid) - g_nodes).cwiseAbs().maxCoeff() < 1e-6);
+
+    std::vector<double> edges{-1.0, 1.0};
+    std::vector<piecewise_polynomial<double, double>> rho_pp;
+    // Coefficients are those of powers of (y + 1): 3(1 - y^2)/4 = 3(y + 1)/2 - 3(y + 1)^2/4
+    Eigen::MatrixXd c0(1, 3);
+    c0 << 0.0, 1.5, -0.75;
+    rho_pp.push_back(piecewise_polynomial<double, double>(1, edges, c0));
+    Eigen::MatrixXd g_pp = proj.project(rho_pp);
+    ASSERT_TRUE((g_pp.col(0) - g_nodes.col(0)).cwiseAbs().maxCoeff() < 1e-12);
+
+    // Sums of poles agree with the DLR
+    dlr d(b);
+    Eigen::MatrixXd c = Eigen::MatrixXd::Random(d.num_poles(), 3);
+    ASSERT_TRUE((proj.project_poles(d.poles(), c) - d.to_ir(c)).cwiseAbs().maxCoeff() < 1e-10);
+}
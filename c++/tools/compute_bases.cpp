@@ -0,0 +1,52 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <irlib/batch.hpp>
+
+/**
+ * Generate IR bases for a list of jobs on all cores.
+ * Usage: compute_bases [-n num_threads] job_file
+ * See read_basis_jobs() for the format of the job file. "-" reads jobs from the standard input.
+ */
+int main(int argc, char **argv) {
+    int num_threads = 0;
+    std::string job_file;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "-n" && i + 1 < argc) {
+            num_threads = std::atoi(argv[++i]);
+        } else if (job_file.empty()) {
+            job_file = arg;
+        } else {
+            job_file.clear();
+            break;
+        }
+    }
+    if (job_file.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-n num_threads] job_file" << std::endl;
+        std::cerr << "Each line of job_file reads" << std::endl;
+        std::cerr << "  statistics(F/B) Lambda [max_dim cutoff r_tol prec n_local_poly num_nodes_gauss_legendre [compression_tol] [output]]" << std::endl;
+        return 1;
+    }
+
+    std::vector<irlib::basis_job> jobs;
+    try {
+        if (job_file == "-") {
+            jobs = irlib::read_basis_jobs(std::cin);
+        } else {
+            std::ifstream ifs(job_file);
+            if (!ifs) {
+                std::cerr << "Cannot open " << job_file << std::endl;
+                return 1;
+            }
+            jobs = irlib::read_basis_jobs(ifs);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return irlib::compute_bases(jobs, num_threads) == 0 ? 0 : 1;
+}
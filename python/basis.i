@@ -3,6 +3,7 @@
 %{
 #define SWIG_FILE_WITH_INIT
 #include <irlib/basis.hpp>
+#include <irlib/transform.hpp>
 
 using namespace irlib;
 %}
@@ -41,10 +42,19 @@ using namespace irlib;
 
 /* These ignore directives must come before including header files */
 %ignore irlib::basis::ulx_mp;
+%rename(project_complex) irlib::projector::project(const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &) const;
+%rename(multiply_complex) irlib::triple_product::multiply(const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &, const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &) const;
+%ignore irlib::triple_product::operator();
+%rename(to_ir_complex) irlib::dlr::to_ir(const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &) const;
+%rename(from_ir_complex) irlib::dlr::from_ir(const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &) const;
+%rename(project_grid) irlib::spectral_projector::project(const std::vector<double> &, const Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic> &) const;
+%rename(synthesize_complex) irlib::synthesizer::synthesize(const Eigen::Matrix<std::complex<double>,Eigen::Dynamic,Eigen::Dynamic> &, const std::vector<double> &) const;
 
 /* Include header files as part of interface file */
 %include <irlib/common.hpp>
+%include <irlib/precision_plan.hpp>
 %include <irlib/basis.hpp>
+%include <irlib/transform.hpp>
 
 %pythoncode {
 from mpmath import *
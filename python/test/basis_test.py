@@ -22,6 +22,96 @@ class TestMethods(unittest.TestCase):
         for Lambda in [0.1, 1.0]:
             b = basis_b(Lambda)
 
+class TestTransforms(unittest.TestCase):
+    """Transforms take and return numpy arrays (number of points or basis functions x number of components)."""
+    def __init__(self, *args, **kwargs):
+        self.b = compute_basis(FERMIONIC, 10.0, 1000, 1e-8, "mp", 1e-8, 64, 10, 24, False)
+        self.dim = self.b.dim()
+        numpy.random.seed(1)
+        self.coeff = numpy.random.rand(self.dim, 3)
+        super(TestTransforms, self).__init__(*args, **kwargs)
+
+    def test_projector(self):
+        p = projector(self.b, 0, 1)
+        x = numpy.array(p.sampling_points())
+        self.assertEqual(len(x), p.num_sampling_points())
+        g = numpy.array([[sum(self.b.ulx(l, xi) * self.coeff[l, k] for l in range(self.dim)) for k in range(3)] for xi in x])
+        coeff = p.project(g)
+        self.assertIsInstance(coeff, numpy.ndarray)
+        self.assertEqual(coeff.shape, (self.dim, 3))
+        self.assertTrue(numpy.allclose(coeff, self.coeff, atol=1e-8))
+        self.assertTrue(numpy.allclose(p.project_complex(1j * g), 1j * self.coeff, atol=1e-8))
+
+    def test_synthesizer(self):
+        s = synthesizer(self.b, 1)
+        x = numpy.linspace(-1, 1, 11)
+        g = s.synthesize(self.coeff, x)
+        self.assertIsInstance(g, numpy.ndarray)
+        self.assertEqual(g.shape, (len(x), 3))
+        for n, xi in enumerate(x):
+            ref = sum(self.b.ulx(l, xi) * self.coeff[l, :] for l in range(self.dim))
+            self.assertTrue(numpy.allclose(g[n, :], ref, atol=1e-8))
+        self.assertTrue(numpy.allclose(s.synthesize_complex((1 + 2j) * self.coeff, x), (1 + 2j) * g, atol=1e-8))
+
+    def test_triple_product(self):
+        t = triple_product(self.b, 1)
+        f = self.coeff[:, 0:2]
+        g = self.coeff[:, 1:3]
+        h = t.multiply(f, g)
+        self.assertIsInstance(h, numpy.ndarray)
+        self.assertEqual(h.shape, (self.dim, 2))
+
+        # h_l = int u_l(x) f(x) g(x) dx
+        p = projector(self.b, 24, 1)
+        s = synthesizer(self.b, 1)
+        x = p.sampling_points()
+        self.assertTrue(numpy.allclose(h, p.project(s.synthesize(f, x) * s.synthesize(g, x)), atol=1e-8))
+        self.assertTrue(numpy.allclose(t.multiply_complex(1j * f, g + 0j), 1j * h, atol=1e-8))
+
+    def test_dlr(self):
+        d = dlr(self.b)
+        poles = numpy.array(d.poles())
+        self.assertEqual(len(poles), d.num_poles())
+        c = numpy.random.rand(d.num_poles(), 2)
+        g = d.to_ir(c)
+        self.assertIsInstance(g, numpy.ndarray)
+        self.assertEqual(g.shape, (self.dim, 2))
+        self.assertTrue(numpy.allclose(d.to_ir(d.from_ir(g)), g, atol=1e-8))
+        self.assertTrue(numpy.allclose(d.to_ir_complex(d.from_ir_complex(1j * g)), 1j * g, atol=1e-8))
+
+        # G_l = -sum_p s_l v_l(y_p) c_p
+        ref = numpy.array([[-sum(self.b.sl(l) * self.b.vly(l, y) * c[p, k] for p, y in enumerate(poles)) for k in range(2)]
+                           for l in range(self.dim)])
+        self.assertTrue(numpy.allclose(g, ref, atol=1e-8))
+
+    def test_spectral_projector(self):
+        sp = spectral_projector(self.b, 0, 1)
+        d = dlr(self.b)
+        c = numpy.random.rand(d.num_poles(), 2)
+        g = sp.project_poles(d.poles(), c)
+        self.assertIsInstance(g, numpy.ndarray)
+        self.assertTrue(numpy.allclose(g, d.to_ir(c), atol=1e-8))
+
+        # A flat spectrum given at the nodes and on a grid
+        y = numpy.linspace(-1, 1, 2001)
+        rho = numpy.full((sp.num_sampling_points(), 1), 0.5)
+        g_nodes = sp.project(rho)
+        g_grid = sp.project_grid(y, numpy.full((len(y), 1), 0.5))
+        self.assertEqual(g_nodes.shape, (self.dim, 1))
+        self.assertTrue(numpy.allclose(g_nodes, g_grid, atol=1e-8))
+
+class TestPrecisionPlan(unittest.TestCase):
+    def test_save_load(self):
+        b = compute_basis(FERMIONIC, 10.0, 1000, 1e-8, "mp", 1e-8, 64, 10, 24, False)
+        plan = b.get_precision_plan()
+        self.assertTrue(plan.kernel_matrix >= 64)
+        self.assertEqual(plan.conversion, b.get_prec_int())
+
+        savetxt("precision_plan_test.txt", b)
+        plan_loaded = loadtxt("precision_plan_test.txt").get_precision_plan()
+        for phase in ["approximate_nodes", "kernel_matrix", "svd", "conversion", "residual"]:
+            self.assertEqual(getattr(plan_loaded, phase), getattr(plan, phase))
+
 if __name__ == '__main__':
     unittest.main()
 
@@ -36,9 +36,10 @@ inline mpfr::mpreal stoscalar<mpfr::mpreal>(const std::string& s) {
    return mpfr::mpreal(s);
 }
 
+/// Parse the hardcoded Gauss-Legendre nodes and weights. Use gauss_legendre_nodes(), which caches the results.
 template<typename T>
 std::vector<std::pair<T,T>>
-gauss_legendre_nodes(int num_nodes) {
+gauss_legendre_nodes_table(int num_nodes) {
 """)
 
 #Note: mpmath gives wrong results for degree==1! 
@@ -66,7 +67,7 @@ for degree in range(2,8):
 """)
 
 print("""
-    throw std::runtime_error("Invalid num_nodes passed to gauss_legendre_nodes");
+    throw std::runtime_error("Invalid num_nodes passed to gauss_legendre_nodes_table");
 }
 
 }